@@ -6,11 +6,13 @@
 #include "i2console.h"
 #include "bsp.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
 
 static const char *TAG = "i2console";
 
@@ -24,6 +26,10 @@ static const char *TAG = "i2console";
 #define REG_RX_AVAIL        0x12
 #define REG_DATA_START      0x20
 #define REG_VERSION_STRING  0x04
+#define REG_LOOPBACK        0x80
+#define REG_TIME_SYNC_MASTER 0x82
+
+#define LOOPBACK_MAX_LEN    64
 
 // Component state
 static struct {
@@ -82,13 +88,26 @@ static bool i2console_detect(void)
 static void i2console_tx_task(void *arg)
 {
     tx_msg_t msg;
+#if CONFIG_I2CONSOLE_TIME_SYNC_INTERVAL_MS > 0
+    const TickType_t wait = pdMS_TO_TICKS(CONFIG_I2CONSOLE_TIME_SYNC_INTERVAL_MS);
+    TickType_t last_sync = xTaskGetTickCount();
+    i2console_time_sync();
+#else
+    const TickType_t wait = portMAX_DELAY;
+#endif
     
     while (1) {
-        if (xQueueReceive(i2console.tx_queue, &msg, portMAX_DELAY) == pdTRUE) {
+        if (xQueueReceive(i2console.tx_queue, &msg, wait) == pdTRUE) {
             if (i2console.connected) {
                 i2console_write_data((uint8_t *)msg.data, msg.len);
             }
         }
+#if CONFIG_I2CONSOLE_TIME_SYNC_INTERVAL_MS > 0
+        if (xTaskGetTickCount() - last_sync >= wait) {
+            last_sync = xTaskGetTickCount();
+            i2console_time_sync();
+        }
+#endif
     }
 }
 
@@ -188,3 +207,88 @@ esp_err_t i2console_get_version(char *version)
     
     return ret;
 }
+
+esp_err_t i2console_time_sync(void)
+{
+    if (!i2console.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint8_t buf[9];
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    buf[0] = REG_TIME_SYNC_MASTER;
+    for (int i = 0; i < 8; i++) {
+        buf[1 + i] = (now >> (8 * i)) & 0xFF;
+    }
+    return i2c_master_transmit(i2console.dev_handle, buf, sizeof(buf), 100);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+esp_err_t i2console_loopback_bench(size_t payload_len, uint32_t iterations,
+                                   i2console_latency_t *result)
+{
+    if (!i2console.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (payload_len == 0 || payload_len > LOOPBACK_MAX_LEN || iterations == 0 || !result) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint32_t *samples = malloc(iterations * sizeof(uint32_t));
+    if (!samples) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    uint8_t tx[LOOPBACK_MAX_LEN + 1];
+    uint8_t rx[LOOPBACK_MAX_LEN];
+    uint8_t reg = REG_LOOPBACK;
+    uint32_t done = 0;
+    uint32_t errors = 0;
+    
+    tx[0] = REG_LOOPBACK;
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (size_t j = 0; j < payload_len; j++) {
+            tx[1 + j] = (uint8_t)(i + j);
+        }
+        
+        int64_t start = esp_timer_get_time();
+        esp_err_t ret = i2c_master_transmit(i2console.dev_handle, tx, payload_len + 1, 100);
+        if (ret == ESP_OK) {
+            ret = i2c_master_transmit_receive(i2console.dev_handle, &reg, 1, rx, payload_len, 100);
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        
+        if (ret != ESP_OK || memcmp(&tx[1], rx, payload_len) != 0) {
+            errors++;
+            continue;
+        }
+        samples[done++] = (uint32_t)elapsed;
+    }
+    
+    memset(result, 0, sizeof(*result));
+    result->iterations = done;
+    result->errors = errors;
+    if (done > 0) {
+        qsort(samples, done, sizeof(uint32_t), compare_u32);
+        result->min_us = samples[0];
+        result->p50_us = samples[(done * 50) / 100];
+        result->p90_us = samples[(done * 90) / 100];
+        result->p99_us = samples[(done * 99) / 100];
+        result->max_us = samples[done - 1];
+    }
+    free(samples);
+    
+    ESP_LOGI(TAG, "Loopback %u bytes x %lu: min %lu p50 %lu p90 %lu p99 %lu max %lu us (%lu errors)",
+             (unsigned)payload_len, (unsigned long)done,
+             (unsigned long)result->min_us, (unsigned long)result->p50_us,
+             (unsigned long)result->p90_us, (unsigned long)result->p99_us,
+             (unsigned long)result->max_us, (unsigned long)errors);
+    
+    return ESP_OK;
+}
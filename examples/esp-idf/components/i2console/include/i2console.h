@@ -18,6 +18,19 @@ extern "C" {
 #define I2CONSOLE_DEVICE_ID     0x12C0
 #define I2CONSOLE_DEFAULT_ADDR  0x37
 
+/**
+ * @brief Round-trip latency statistics from a loopback benchmark (microseconds)
+ */
+typedef struct {
+    uint32_t iterations;    ///< Round trips completed
+    uint32_t errors;        ///< Bus errors or payload mismatches
+    uint32_t min_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} i2console_latency_t;
+
 /**
  * @brief Initialize I2Console component
  * 
@@ -54,6 +67,30 @@ bool i2console_is_connected(void);
  */
 esp_err_t i2console_get_version(char *version);
 
+/**
+ * @brief Send the local time (esp_timer, µs) to the device's time-sync register
+ * 
+ * The device latches its own clock at the same moment and derives offset and
+ * drift, so its log timestamps line up with this master's clock.
+ * 
+ * @return ESP_OK on success
+ */
+esp_err_t i2console_time_sync(void);
+
+/**
+ * @brief Measure master-to-device round-trip latency via the loopback register
+ * 
+ * Writes a payload to the loopback register, reads it back and times each
+ * round trip. Runs on the caller's task and shares the bus with log output.
+ * 
+ * @param payload_len Bytes per round trip (1-64)
+ * @param iterations Number of round trips to time
+ * @param result Latency percentiles
+ * @return ESP_OK on success
+ */
+esp_err_t i2console_loopback_bench(size_t payload_len, uint32_t iterations,
+                                   i2console_latency_t *result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,13 @@ void app_main(void)
             ESP_LOGI(TAG, "I2Console firmware: %s", version);
         }
         
+#ifdef CONFIG_I2CONSOLE_LOOPBACK_BENCH
+        // Measure round-trip latency through the loopback register
+        i2console_latency_t latency;
+        i2console_loopback_bench(CONFIG_I2CONSOLE_LOOPBACK_BENCH_LEN,
+                                 CONFIG_I2CONSOLE_LOOPBACK_BENCH_ITERATIONS, &latency);
+#endif
+        
         ESP_LOGI(TAG, "All ESP_LOG output is now mirrored to I2Console!");
     } else {
         ESP_LOGW(TAG, "I2Console not found - continuing with UART only");
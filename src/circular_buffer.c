@@ -6,10 +6,12 @@ void circular_buffer_init(circular_buffer_t *cb, uint8_t *buffer, size_t size) {
     cb->head = 0;
     cb->tail = 0;
     cb->count = 0;
+    cb->policy = CB_DROP_OLDEST;
 }
 
 bool circular_buffer_push(circular_buffer_t *cb, uint8_t data) {
     if (cb->count >= cb->size) {
+        if (cb->policy == CB_DROP_NEWEST) return false;
         // Drop oldest
         cb->tail = (cb->tail + 1) % cb->size;
         cb->count--;
@@ -43,3 +45,38 @@ void circular_buffer_clear(circular_buffer_t *cb) {
     cb->tail = 0;
     cb->count = 0;
 }
+
+// Writes only what fits; never drops existing data
+size_t circular_buffer_write(circular_buffer_t *cb, const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (n < len && cb->count < cb->size) {
+        cb->buffer[cb->head] = data[n++];
+        cb->head = (cb->head + 1) % cb->size;
+        cb->count++;
+    }
+    return n;
+}
+
+size_t circular_buffer_read(circular_buffer_t *cb, uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (n < len && cb->count > 0) {
+        data[n++] = cb->buffer[cb->tail];
+        cb->tail = (cb->tail + 1) % cb->size;
+        cb->count--;
+    }
+    return n;
+}
+
+size_t circular_buffer_peek(circular_buffer_t *cb, uint8_t *data, size_t len) {
+    size_t n = 0;
+    size_t pos = cb->tail;
+    while (n < len && n < cb->count) {
+        data[n++] = cb->buffer[pos];
+        pos = (pos + 1) % cb->size;
+    }
+    return n;
+}
+
+void circular_buffer_set_policy(circular_buffer_t *cb, circular_buffer_policy_t policy) {
+    cb->policy = policy;
+}
@@ -5,12 +5,19 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// What circular_buffer_push() does when the buffer is full
+typedef enum {
+    CB_DROP_OLDEST = 0,  // overwrite the oldest byte (default)
+    CB_DROP_NEWEST       // reject the new byte; push returns false
+} circular_buffer_policy_t;
+
 typedef struct {
     uint8_t *buffer;
     size_t size;
     size_t head;
     size_t tail;
     size_t count;
+    circular_buffer_policy_t policy;
 } circular_buffer_t;
 
 void circular_buffer_init(circular_buffer_t *cb, uint8_t *buffer, size_t size);
@@ -19,5 +26,10 @@ bool circular_buffer_pop(circular_buffer_t *cb, uint8_t *data);
 size_t circular_buffer_available(circular_buffer_t *cb);
 size_t circular_buffer_free(circular_buffer_t *cb);
 void circular_buffer_clear(circular_buffer_t *cb);
+size_t circular_buffer_write(circular_buffer_t *cb, const uint8_t *data, size_t len);
+size_t circular_buffer_read(circular_buffer_t *cb, uint8_t *data, size_t len);
+// Copies up to len of the oldest bytes without consuming them
+size_t circular_buffer_peek(circular_buffer_t *cb, uint8_t *data, size_t len);
+void circular_buffer_set_policy(circular_buffer_t *cb, circular_buffer_policy_t policy);
 
 #endif
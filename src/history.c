@@ -0,0 +1,127 @@
+#include "history.h"
+#include "circular_buffer.h"
+#include "i2c_slave.h"
+#include "log.h"
+#include "ram_budget.h"
+#include "version.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t console_data[HISTORY_CONSOLE_SIZE];
+static uint8_t log_data[HISTORY_LOG_SIZE];
+static circular_buffer_t console_ring;
+static circular_buffer_t log_ring;
+
+static uint8_t console_snapshot[HISTORY_CONSOLE_SIZE];
+static uint8_t log_snapshot[HISTORY_LOG_SIZE];
+static char info_snapshot[HISTORY_INFO_SIZE];
+
+static size_t sizes[HISTORY_FILE_COUNT];
+static uint32_t snapshots = 0;
+
+void history_init(void) {
+    circular_buffer_init(&console_ring, console_data, HISTORY_CONSOLE_SIZE);
+    circular_buffer_init(&log_ring, log_data, HISTORY_LOG_SIZE);
+    i2c_slave_set_console_mirror(&console_ring);
+    log_set_capture(&log_ring);
+
+    ram_budget_add("Console history + snapshot", 2 * HISTORY_CONSOLE_SIZE);
+    ram_budget_add("Log history + snapshot", 2 * HISTORY_LOG_SIZE);
+    history_snapshot();
+}
+
+// The console ring is filled from the I2C interrupt, which must not be held
+// off for a whole copy: only the indices are read with interrupts disabled.
+// Bytes pushed during the copy may have overwritten the oldest ones copied,
+// so that many are trimmed from the front afterwards. The copy takes far
+// less time than refilling the ring, so the head delta can't wrap.
+static size_t snapshot_ring(circular_buffer_t *cb, uint8_t *dst) {
+    uint32_t ints = save_and_disable_interrupts();
+    size_t tail = cb->tail;
+    size_t head = cb->head;
+    size_t count = cb->count;
+    restore_interrupts(ints);
+
+    size_t first = cb->size - tail;
+    if (first > count) first = count;
+    memcpy(dst, &cb->buffer[tail], first);
+    memcpy(dst + first, cb->buffer, count - first);
+
+    ints = save_and_disable_interrupts();
+    size_t written = (cb->head + cb->size - head) % cb->size;
+    restore_interrupts(ints);
+
+    size_t free_before = cb->size - count;
+    size_t lost = written > free_before ? written - free_before : 0;
+    if (lost > count) lost = count;
+    memmove(dst, dst + lost, count - lost);
+    return count - lost;
+}
+
+void history_snapshot(void) {
+    sizes[HISTORY_FILE_CONSOLE] = snapshot_ring(&console_ring, console_snapshot);
+    sizes[HISTORY_FILE_LOG] = snapshot_ring(&log_ring, log_snapshot);
+
+    snapshots++;
+    i2c_stats_t st = i2c_slave_get_stats();
+    uint32_t ms = to_ms_since_boot(get_absolute_time());
+    int n = snprintf(info_snapshot, sizeof(info_snapshot),
+                     "I2Console %s\r\n"
+                     "Snapshot %lu at %lu.%03lu s since boot\r\n"
+                     "CONSOLE.TXT: last %u bytes of console output (of %lu written)\r\n"
+                     "LOG.TXT: last %u bytes of log output\r\n",
+                     FW_VERSION, (unsigned long)snapshots,
+                     (unsigned long)(ms / 1000), (unsigned long)(ms % 1000),
+                     (unsigned)sizes[HISTORY_FILE_CONSOLE],
+                     (unsigned long)(st.tx_bytes + st.channel_bytes[I2C_CHANNEL_CONSOLE]),
+                     (unsigned)sizes[HISTORY_FILE_LOG]);
+    if (n < 0) n = 0;
+    if (n >= (int)sizeof(info_snapshot)) n = sizeof(info_snapshot) - 1;
+    sizes[HISTORY_FILE_INFO] = n;
+}
+
+uint32_t history_snapshot_count(void) {
+    return snapshots;
+}
+
+size_t history_file_size(history_file_t file) {
+    return file < HISTORY_FILE_COUNT ? sizes[file] : 0;
+}
+
+size_t history_file_capacity(history_file_t file) {
+    switch (file) {
+    case HISTORY_FILE_INFO:
+        return HISTORY_INFO_SIZE;
+    case HISTORY_FILE_CONSOLE:
+        return HISTORY_CONSOLE_SIZE;
+    case HISTORY_FILE_LOG:
+        return HISTORY_LOG_SIZE;
+    default:
+        return 0;
+    }
+}
+
+size_t history_read(history_file_t file, uint32_t offset, uint8_t *buf, size_t len) {
+    const uint8_t *src;
+    switch (file) {
+    case HISTORY_FILE_INFO:
+        src = (const uint8_t *)info_snapshot;
+        break;
+    case HISTORY_FILE_CONSOLE:
+        src = console_snapshot;
+        break;
+    case HISTORY_FILE_LOG:
+        src = log_snapshot;
+        break;
+    default:
+        return 0;
+    }
+
+    size_t size = sizes[file];
+    if (offset >= size) return 0;
+    if (len > size - offset) len = size - offset;
+    memcpy(buf, src + offset, len);
+    return len;
+}
@@ -0,0 +1,34 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Capture of console output and log lines for export over USB mass storage.
+// Both are kept in drop-oldest rings; history_snapshot() copies them into
+// stable buffers that the host reads as files.
+#ifndef HISTORY_CONSOLE_SIZE
+#define HISTORY_CONSOLE_SIZE 32768
+#endif
+#ifndef HISTORY_LOG_SIZE
+#define HISTORY_LOG_SIZE 8192
+#endif
+#define HISTORY_INFO_SIZE 512
+
+typedef enum {
+    HISTORY_FILE_INFO = 0,
+    HISTORY_FILE_CONSOLE,
+    HISTORY_FILE_LOG,
+    HISTORY_FILE_COUNT
+} history_file_t;
+
+void history_init(void);
+// Freezes the current ring contents as the exported files
+void history_snapshot(void);
+uint32_t history_snapshot_count(void);
+size_t history_file_size(history_file_t file);
+size_t history_file_capacity(history_file_t file);
+// Copies up to len bytes from offset; returns the number copied
+size_t history_read(history_file_t file, uint32_t offset, uint8_t *buf, size_t len);
+
+#endif
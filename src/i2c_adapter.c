@@ -0,0 +1,330 @@
+#include "i2c_adapter.h"
+#include "log.h"
+#include "ram_budget.h"
+#include "tusb.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+#include "pico/time.h"
+
+typedef enum {
+    BATCH_MAGIC = 0,
+    BATCH_SEQ,
+    BATCH_LEN_LO,
+    BATCH_LEN_HI,
+    BATCH_BODY
+} batch_state_t;
+
+static i2c_adapter_stats_t stats = {0};
+
+static uint8_t batch[ADAPTER_BATCH_SIZE];
+static batch_state_t batch_state = BATCH_MAGIC;
+static uint8_t batch_seq = 0;
+static uint16_t batch_len = 0;
+static uint16_t batch_received = 0;
+
+static uint8_t in_buf[64];
+static uint32_t in_len = 0;
+static uint32_t in_pos = 0;
+
+// Reply is sent over as many task calls as the endpoint FIFO needs;
+// no new batch is parsed until it is out
+static uint8_t reply[6 + ADAPTER_REPLY_SIZE];
+static uint16_t reply_len = 0;
+static uint16_t reply_sent = 0;
+
+// A batch runs over several task calls: a slice of commands per call and
+// DELAY commands as deadlines, so the main loop (and watchdog) keeps going
+static bool batch_running = false;
+static uint16_t exec_pos = 0;
+static uint16_t exec_out = 6;
+static uint8_t exec_status = ADAPTER_OK;
+static uint8_t exec_done = 0;
+static uint64_t delay_until_us = 0;
+// The last transfer skipped its STOP, so i2c1 still owns the bus
+static bool bus_held = false;
+
+void i2c_adapter_init(void) {
+    i2c_init(i2c1, I2C_ADAPTER_DEFAULT_KHZ * 1000);
+    gpio_set_function(I2C_ADAPTER_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_ADAPTER_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_ADAPTER_SDA_PIN);
+    gpio_pull_up(I2C_ADAPTER_SCL_PIN);
+    stats.speed_khz = I2C_ADAPTER_DEFAULT_KHZ;
+    ram_budget_add("I2C adapter batch/reply", sizeof(batch) + sizeof(reply));
+    LOG_INFO("I2C adapter on GPIO%d/%d at %d kHz",
+             I2C_ADAPTER_SDA_PIN, I2C_ADAPTER_SCL_PIN, I2C_ADAPTER_DEFAULT_KHZ);
+}
+
+static uint8_t transfer_status(int ret) {
+    if (ret == PICO_ERROR_TIMEOUT) {
+        stats.timeouts++;
+        return ADAPTER_ERR_TIMEOUT;
+    }
+    if (ret < 0) {
+        stats.nacks++;
+        return ADAPTER_ERR_NACK;
+    }
+    return ADAPTER_OK;
+}
+
+// Resetting the block releases SDA/SCL and drops the pending repeated
+// start that a STOP-less transfer leaves behind
+static void release_bus(void) {
+    i2c_deinit(i2c1);
+    stats.speed_khz = i2c_init(i2c1, stats.speed_khz * 1000) / 1000;
+    bus_held = false;
+    stats.bus_resets++;
+}
+
+// Number of commands in the batch, stopping at the first malformed one
+// (run_batch() reports that)
+static uint16_t count_commands(void) {
+    uint16_t count = 0;
+    uint16_t pos = 0;
+    while (pos < batch_len) {
+        uint8_t op = batch[pos] & ~ADAPTER_NOSTOP;
+        uint16_t size;
+        if (op == ADAPTER_CMD_WRITE) {
+            if (batch_len - pos < 3) break;
+            size = 3 + batch[pos + 2];
+        } else if (op == ADAPTER_CMD_PROBE) {
+            size = 2;
+        } else {
+            size = 3;
+        }
+        pos += size;
+        count++;
+    }
+    return count;
+}
+
+static void start_batch(void) {
+    exec_pos = 0;
+    exec_out = 6;
+    exec_status = ADAPTER_OK;
+    exec_done = 0;
+    delay_until_us = 0;
+    batch_running = true;
+    // done is a single byte in the reply
+    if (count_commands() > ADAPTER_MAX_COMMANDS) exec_status = ADAPTER_ERR_BAD_CMD;
+}
+
+static void finish_batch(void) {
+    batch_running = false;
+    if (bus_held) release_bus();
+    if (exec_status == ADAPTER_ERR_BAD_CMD) stats.bad_batches++;
+    stats.batches++;
+
+    uint16_t data_len = exec_out - 6;
+    reply[0] = ADAPTER_REPLY_MAGIC;
+    reply[1] = batch_seq;
+    reply[2] = exec_status;
+    reply[3] = exec_done;
+    reply[4] = data_len & 0xFF;
+    reply[5] = data_len >> 8;
+    reply_len = exec_out;
+    reply_sent = 0;
+}
+
+static void run_batch(void) {
+    uint64_t now = time_us_64();
+    if (now < delay_until_us) return;
+
+    uint16_t pos = exec_pos;
+    uint16_t out = exec_out;
+    uint8_t status = exec_status;
+    uint8_t done = exec_done;
+    uint64_t slice_end = now + ADAPTER_SLICE_US;
+    bool waiting = false;
+
+    while (pos < batch_len && status == ADAPTER_OK && !waiting &&
+           time_us_64() < slice_end) {
+        uint8_t op = batch[pos++];
+        bool nostop = op & ADAPTER_NOSTOP;
+        uint16_t remaining = batch_len - pos;
+
+        switch (op & ~ADAPTER_NOSTOP) {
+        case ADAPTER_CMD_WRITE: {
+            if (remaining < 2 || remaining - 2 < batch[pos + 1] || batch[pos + 1] == 0) {
+                status = ADAPTER_ERR_BAD_CMD;
+                break;
+            }
+            uint8_t addr = batch[pos];
+            uint8_t len = batch[pos + 1];
+            int ret = i2c_write_timeout_us(i2c1, addr, &batch[pos + 2], len, nostop,
+                                           ADAPTER_BYTE_TIMEOUT_US * (len + 1));
+            bus_held = nostop;
+            status = transfer_status(ret);
+            if (status == ADAPTER_OK) stats.bytes_written += len;
+            stats.transfers++;
+            pos += 2 + len;
+            break;
+        }
+        case ADAPTER_CMD_READ: {
+            if (remaining < 2 || batch[pos + 1] == 0) {
+                status = ADAPTER_ERR_BAD_CMD;
+                break;
+            }
+            uint8_t addr = batch[pos];
+            uint8_t len = batch[pos + 1];
+            if ((size_t)out + len > sizeof(reply)) {
+                status = ADAPTER_ERR_REPLY;
+                break;
+            }
+            int ret = i2c_read_timeout_us(i2c1, addr, &reply[out], len, nostop,
+                                          ADAPTER_BYTE_TIMEOUT_US * (len + 1));
+            bus_held = nostop;
+            status = transfer_status(ret);
+            if (status == ADAPTER_OK) {
+                out += len;
+                stats.bytes_read += len;
+            }
+            stats.transfers++;
+            pos += 2;
+            break;
+        }
+        case ADAPTER_CMD_PROBE: {
+            if (remaining < 1) {
+                status = ADAPTER_ERR_BAD_CMD;
+                break;
+            }
+            if ((size_t)out + 1 > sizeof(reply)) {
+                status = ADAPTER_ERR_REPLY;
+                break;
+            }
+            // One-byte read, as a zero-length write isn't supported;
+            // a NACK here is a result, not an error
+            uint8_t dummy;
+            int ret = i2c_read_timeout_us(i2c1, batch[pos], &dummy, 1, false,
+                                          ADAPTER_BYTE_TIMEOUT_US * 2);
+            bus_held = false;
+            reply[out++] = ret >= 0 ? 1 : 0;
+            stats.transfers++;
+            pos += 1;
+            break;
+        }
+        case ADAPTER_CMD_SPEED: {
+            uint16_t khz = remaining >= 2 ? batch[pos] | (batch[pos + 1] << 8) : 0;
+            if (khz == 0 || khz > 1000) {
+                status = ADAPTER_ERR_BAD_CMD;
+                break;
+            }
+            stats.speed_khz = i2c_set_baudrate(i2c1, khz * 1000) / 1000;
+            pos += 2;
+            break;
+        }
+        case ADAPTER_CMD_DELAY:
+            if (remaining < 2) {
+                status = ADAPTER_ERR_BAD_CMD;
+                break;
+            }
+            delay_until_us = time_us_64() + (batch[pos] | (batch[pos + 1] << 8));
+            waiting = true;
+            pos += 2;
+            break;
+        default:
+            status = ADAPTER_ERR_BAD_CMD;
+            break;
+        }
+
+        if (status == ADAPTER_OK) done++;
+    }
+
+    exec_pos = pos;
+    exec_out = out;
+    exec_status = status;
+    exec_done = done;
+    // A trailing DELAY still has to elapse before the reply goes out
+    if ((pos >= batch_len || status != ADAPTER_OK) && !waiting) finish_batch();
+}
+
+static void send_reply(void) {
+    uint32_t space = tud_vendor_n_write_available(I2C_ADAPTER_VENDOR_ITF);
+    uint32_t n = reply_len - reply_sent;
+    if (n > space) n = space;
+    if (n > 0) {
+        reply_sent += tud_vendor_n_write(I2C_ADAPTER_VENDOR_ITF, &reply[reply_sent], n);
+    }
+    if (reply_sent == reply_len) {
+        reply_len = 0;
+        reply_sent = 0;
+    }
+    tud_vendor_n_write_flush(I2C_ADAPTER_VENDOR_ITF);
+}
+
+void i2c_adapter_task(void) {
+    if (!tud_vendor_n_mounted(I2C_ADAPTER_VENDOR_ITF)) {
+        batch_state = BATCH_MAGIC;
+        batch_running = false;
+        if (bus_held) release_bus();
+        reply_len = 0;
+        in_len = in_pos = 0;
+        return;
+    }
+
+    if (batch_running) {
+        run_batch();
+        if (batch_running) return;
+    }
+
+    if (reply_len > 0) {
+        send_reply();
+        if (reply_len > 0) return;
+    }
+
+    // Bytes past the end of a batch wait in in_buf until its reply is out
+    while (reply_len == 0 && !batch_running) {
+        if (in_pos == in_len) {
+            if (!tud_vendor_n_available(I2C_ADAPTER_VENDOR_ITF)) break;
+            in_len = tud_vendor_n_read(I2C_ADAPTER_VENDOR_ITF, in_buf, sizeof(in_buf));
+            in_pos = 0;
+            if (in_len == 0) break;
+        }
+
+        uint8_t c = in_buf[in_pos++];
+        switch (batch_state) {
+        case BATCH_MAGIC:
+            if (c == ADAPTER_BATCH_MAGIC) {
+                batch_state = BATCH_SEQ;
+            } else {
+                stats.bad_batches++;
+            }
+            break;
+        case BATCH_SEQ:
+            batch_seq = c;
+            batch_state = BATCH_LEN_LO;
+            break;
+        case BATCH_LEN_LO:
+            batch_len = c;
+            batch_state = BATCH_LEN_HI;
+            break;
+        case BATCH_LEN_HI:
+            batch_len |= c << 8;
+            batch_received = 0;
+            if (batch_len > ADAPTER_BATCH_SIZE) {
+                stats.bad_batches++;
+                batch_state = BATCH_MAGIC;
+            } else if (batch_len == 0) {
+                start_batch();
+                batch_state = BATCH_MAGIC;
+            } else {
+                batch_state = BATCH_BODY;
+            }
+            break;
+        case BATCH_BODY:
+            batch[batch_received++] = c;
+            if (batch_received == batch_len) {
+                start_batch();
+                batch_state = BATCH_MAGIC;
+            }
+            break;
+        }
+    }
+
+    if (batch_running) run_batch();
+    if (reply_len > 0) send_reply();
+}
+
+i2c_adapter_stats_t i2c_adapter_get_stats(void) {
+    return stats;
+}
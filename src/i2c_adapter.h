@@ -0,0 +1,59 @@
+#ifndef I2C_ADAPTER_H
+#define I2C_ADAPTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// USB-to-I2C master adapter on i2c1, driven over a vendor bulk interface
+#define I2C_ADAPTER_SDA_PIN 2
+#define I2C_ADAPTER_SCL_PIN 3
+#define I2C_ADAPTER_DEFAULT_KHZ 400
+#define I2C_ADAPTER_VENDOR_ITF 0
+
+// Batch: [0xA5][seq][len LE16][commands...]
+// Reply: [0x5A][seq][status][done][len LE16][read data...]
+#define ADAPTER_BATCH_MAGIC 0xA5
+#define ADAPTER_REPLY_MAGIC 0x5A
+#define ADAPTER_BATCH_SIZE 1024
+#define ADAPTER_REPLY_SIZE 1024
+// done is one byte, so longer batches are rejected with ADAPTER_ERR_BAD_CMD
+#define ADAPTER_MAX_COMMANDS 255
+
+// Commands. OR ADAPTER_NOSTOP into READ/WRITE to end with a repeated start.
+#define ADAPTER_CMD_WRITE 0x01  // [addr][len][data...]
+#define ADAPTER_CMD_READ  0x02  // [addr][len] -> len bytes
+#define ADAPTER_CMD_PROBE 0x03  // [addr] -> 1 if ACKed, 0 otherwise
+#define ADAPTER_CMD_SPEED 0x10  // [kHz LE16]
+#define ADAPTER_CMD_DELAY 0x11  // [µs LE16]
+#define ADAPTER_NOSTOP    0x80
+
+// Reply status; a batch stops at the first failing command
+#define ADAPTER_OK          0x00
+#define ADAPTER_ERR_NACK    0x01
+#define ADAPTER_ERR_TIMEOUT 0x02
+#define ADAPTER_ERR_BAD_CMD 0x03
+#define ADAPTER_ERR_REPLY   0x04  // read data would not fit in the reply
+
+// Per-byte transfer timeout, leaves room for target clock stretching
+#define ADAPTER_BYTE_TIMEOUT_US 1000
+// Batches run in slices of about this long per task call; DELAY commands
+// don't block, so a long batch never holds up the main loop
+#define ADAPTER_SLICE_US 2000
+
+typedef struct {
+    uint32_t batches;
+    uint32_t transfers;
+    uint32_t bytes_written;
+    uint32_t bytes_read;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t bad_batches;
+    uint32_t bus_resets;     // i2c1 reset to release a bus left without STOP
+    uint32_t speed_khz;
+} i2c_adapter_stats_t;
+
+void i2c_adapter_init(void);
+void i2c_adapter_task(void);
+i2c_adapter_stats_t i2c_adapter_get_stats(void);
+
+#endif
@@ -1,11 +1,17 @@
 #include "i2c_slave.h"
 #include "flash_config.h"
 #include "log.h"
+#include "ram_budget.h"
+#include "prbs.h"
+#include "time_sync.h"
+#include "usb_stream.h"
 #include "version.h"
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
 #include "hardware/irq.h"
 #include "hardware/regs/i2c.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -32,84 +38,507 @@ static circular_buffer_t *rx_buffer;
 static i2c_stats_t stats = {0};
 static uint8_t current_register = 0;
 static bool register_set = false;
-static bool is_read_mode = false;
+static uint8_t ctrl_flags = 0;
+// Set by the doorbell register or STOP after console data; consumed by main loop
+static volatile bool flush_requested = false;
+static bool console_written = false;
+static bool transaction_started = false;
+
+// Long-poll: a read of REG_RX_LONGPOLL with nothing to return leaves RD_REQ
+// unanswered, so the controller stretches SCL until data arrives or times out
+static uint8_t longpoll_timeout_ms = LONGPOLL_DEFAULT_TIMEOUT_MS;
+static volatile bool longpoll_pending = false;
+static alarm_id_t longpoll_alarm = 0;
+// Urgent slot: console input bytes flagged in urgent_set skip the RX buffer
+// so the master sees them ahead of any queued paste
+static uint8_t urgent_data[URGENT_BUFFER_SIZE];
+static circular_buffer_t urgent_buffer;
+static uint8_t urgent_set[32];
+static uint8_t urgent_write_byte = 0;
+
+// PRBS counters are snapshotted on the first byte of a REG_PRBS_STATS read
+static prbs_stats_t prbs_snapshot;
+_Static_assert(sizeof(prbs_stats_t) == 4 * sizeof(uint32_t), "REG_PRBS_STATS layout");
+
+// Transaction metadata: single producer (ISR at STOP), single consumer
+// (main loop). Head and tail only ever advance, masked on access.
+static i2c_txn_t txn_log[I2C_TXN_LOG_SIZE];
+static volatile uint32_t txn_head = 0;
+static volatile uint32_t txn_tail = 0;
+static i2c_txn_t txn_current;
+
+// Hang watchdog state, updated by the ISR and checked by i2c_slave_task()
+static volatile uint32_t last_activity_us = 0;
+static volatile uint8_t error_streak = 0;
+static volatile bool recover_requested = false;
+static uint32_t bus_low_since_us = 0;
+static bool bus_low = false;
+static uint32_t bus_low_sample_us = 0;
+static uint8_t bus_low_samples = 0;
+static bool bus_low_handled = false;  // one reset per stuck-low episode
+
+// Byte position within the current register access (multi-byte registers)
+static uint8_t write_index = 0;
+static uint8_t read_index = 0;
+
+// Loopback: bytes written to REG_LOOPBACK/REG_LOOPBACK_TS are read back on
+// the next read. REG_LOOPBACK_TS appends the time_us_32() value latched when
+// the first byte of the write arrived (4 bytes, little endian).
+static uint8_t loopback_data[LOOPBACK_BUFFER_SIZE];
+static circular_buffer_t loopback_buffer;
+static uint32_t loopback_timestamp = 0;
+static uint8_t loopback_ts_index = 0;
+
+// Time sync: the master writes its time (8 bytes, LE, µs) to
+// REG_TIME_SYNC_MASTER; time_us_64() is latched when the first byte arrives
+// and can be read back from REG_TIME_SYNC_DEVICE.
+static uint64_t sync_master_us = 0;
+static uint64_t sync_device_us = 0;
+static uint64_t sync_latch_us = 0;
+
+// Channel demux: REG_CHANNEL_DATA carries [channel][len][payload...] frames.
+// Payload bytes go straight into the channel's own buffer, so a full channel
+// only ever drops its own data.
+typedef enum {
+    FRAME_CHANNEL = 0,
+    FRAME_LENGTH,
+    FRAME_PAYLOAD
+} frame_state_t;
+
+static circular_buffer_t *channel_buffers[I2C_CHANNEL_COUNT];
+// Optional copy of everything written to the console (history capture)
+static circular_buffer_t *console_mirror = NULL;
+static frame_state_t frame_state = FRAME_CHANNEL;
+static uint8_t frame_channel = 0;
+static uint8_t frame_remaining = 0;
+
+static void channel_write(uint8_t index, uint8_t data) {
+    if (index == 0) {
+        // Frames never span transactions
+        frame_state = FRAME_CHANNEL;
+    }
+
+    switch (frame_state) {
+    case FRAME_CHANNEL:
+        frame_channel = data;
+        frame_state = FRAME_LENGTH;
+        break;
+    case FRAME_LENGTH:
+        frame_remaining = data;
+        frame_state = data ? FRAME_PAYLOAD : FRAME_CHANNEL;
+        if (frame_channel >= I2C_CHANNEL_COUNT || !channel_buffers[frame_channel]) {
+            stats.frame_errors++;
+        }
+        break;
+    case FRAME_PAYLOAD:
+        if (frame_channel < I2C_CHANNEL_COUNT && channel_buffers[frame_channel]) {
+            circular_buffer_t *buf = channel_buffers[frame_channel];
+            if (circular_buffer_free(buf) == 0) {
+                stats.channel_overflow[frame_channel]++;
+            }
+            // Under CB_DROP_NEWEST a full ring rejects the byte
+            if (circular_buffer_push(buf, data)) stats.channel_bytes[frame_channel]++;
+            if (frame_channel == I2C_CHANNEL_CONSOLE && console_mirror) {
+                circular_buffer_push(console_mirror, data);
+            }
+        }
+        if (--frame_remaining == 0) {
+            frame_state = FRAME_CHANNEL;
+        }
+        break;
+    }
+}
+
+static inline bool is_data_register(uint8_t reg) {
+    return reg >= REG_DATA_START && reg <= REG_DATA_END;
+}
+
+// Register file shared by all transports. Must be called with the I2C IRQ
+// masked or from an interrupt of the same priority.
+void i2c_slave_reg_write(uint8_t reg, uint8_t index, uint8_t data) {
+    if (reg == REG_I2C_ADDRESS) {
+        flash_config_set_i2c_address(data);
+    } else if (reg == REG_CLOCK_STRETCH) {
+        flash_config_set_clock_stretch(data & 0x01);
+    } else if (reg == REG_LOOPBACK || reg == REG_LOOPBACK_TS) {
+        if (index == 0) {
+            circular_buffer_clear(&loopback_buffer);
+            loopback_timestamp = time_us_32();
+            loopback_ts_index = 0;
+        }
+        circular_buffer_push(&loopback_buffer, data);
+    } else if (reg == REG_TIME_SYNC_MASTER) {
+        if (index == 0) {
+            sync_latch_us = time_us_64();
+            sync_master_us = 0;
+        }
+        if (index < 8) {
+            sync_master_us |= (uint64_t)data << (8 * index);
+            if (index == 7) {
+                sync_device_us = sync_latch_us;
+                time_sync_submit(sync_master_us, sync_device_us);
+            }
+        }
+    } else if (reg == REG_CHANNEL_DATA) {
+        channel_write(index, data);
+        console_written = true;
+    } else if (reg == REG_FLUSH) {
+        if (index == 0) {
+            flush_requested = true;
+            stats.flush_requests++;
+        }
+    } else if (reg == REG_CTRL) {
+        ctrl_flags = data;
+    } else if (reg == REG_LONGPOLL_TIMEOUT) {
+        longpoll_timeout_ms = data ? data : 1;
+    } else if (reg == REG_PRBS_SINK) {
+        prbs_sink_byte(data);
+    } else if (reg == REG_PRBS_STATS) {
+        if (index == 0) prbs_reset();
+    } else if (reg == REG_URGENT) {
+        // [byte][enable]: add or remove a byte from the urgent set
+        if (index == 0) {
+            urgent_write_byte = data;
+        } else if (index == 1) {
+            if (data) {
+                urgent_set[urgent_write_byte >> 3] |= 1u << (urgent_write_byte & 7);
+            } else {
+                urgent_set[urgent_write_byte >> 3] &= ~(1u << (urgent_write_byte & 7));
+            }
+        }
+    } else if (is_data_register(reg)) {
+        if (console_mirror) {
+            circular_buffer_push(console_mirror, data);
+        }
+        if (!circular_buffer_push(tx_buffer, data)) {
+            stats.tx_overflow++;
+        } else {
+            stats.tx_bytes++;
+        }
+        console_written = true;
+    }
+}
+
+uint8_t i2c_slave_reg_read(uint8_t reg, uint8_t index) {
+    uint8_t data = 0;
+
+    if (reg == REG_DEVICE_ID) {
+        // Return device ID as 2-byte sequence from single register,
+        // high byte first
+        if ((index & 1) == 0) {
+            data = (DEVICE_ID >> 8) & 0xFF;
+        } else {
+            data = DEVICE_ID & 0xFF;
+        }
+    } else if (reg == REG_FW_VERSION) {
+        data = fw_version_byte;
+    } else if (reg >= 0x04 && reg < 0x04 + sizeof(version_short)) {
+        // Version string registers 0x04-0x13
+        data = version_short[reg - 0x04];
+    } else if (reg == REG_I2C_ADDRESS) {
+        data = flash_config_get_i2c_address();
+    } else if (reg == REG_CLOCK_STRETCH) {
+        data = flash_config_get_clock_stretch() ? 1 : 0;
+    } else if (reg == REG_TX_AVAIL_LOW) {
+        uint16_t avail = circular_buffer_available(tx_buffer);
+        data = avail & 0xFF;
+    } else if (reg == REG_TX_AVAIL_HIGH) {
+        uint16_t avail = circular_buffer_available(tx_buffer);
+        data = (avail >> 8) & 0xFF;
+    } else if (reg == REG_RX_AVAIL) {
+        data = circular_buffer_available(rx_buffer) & 0xFF;
+    } else if (reg == REG_LOOPBACK) {
+        circular_buffer_pop(&loopback_buffer, &data);
+    } else if (reg == REG_LOOPBACK_TS) {
+        if (!circular_buffer_pop(&loopback_buffer, &data) && loopback_ts_index < 4) {
+            data = (loopback_timestamp >> (8 * loopback_ts_index)) & 0xFF;
+            loopback_ts_index++;
+        }
+    } else if (reg == REG_CTRL) {
+        data = ctrl_flags;
+    } else if (reg == REG_LONGPOLL_TIMEOUT) {
+        data = longpoll_timeout_ms;
+    } else if (reg == REG_STATUS) {
+        if (circular_buffer_available(&urgent_buffer) > 0) data |= STATUS_URGENT;
+        if (circular_buffer_available(rx_buffer) > 0) data |= STATUS_RX_DATA;
+        if (circular_buffer_available(tx_buffer) > 0) data |= STATUS_TX_DATA;
+    } else if (reg == REG_URGENT) {
+        circular_buffer_pop(&urgent_buffer, &data);
+    } else if (reg == REG_PRBS_SOURCE) {
+        data = prbs_source_byte();
+    } else if (reg == REG_PRBS_STATS) {
+        // source bytes, sink bytes, bit errors, byte errors (u32 LE each)
+        if (index == 0) prbs_snapshot = prbs_get_stats();
+        if (index < 16) {
+            uint32_t fields[4];
+            memcpy(fields, &prbs_snapshot, sizeof(fields));
+            data = (fields[index / 4] >> (8 * (index % 4))) & 0xFF;
+        }
+    } else if (reg == REG_RX_LONGPOLL) {
+        // First byte: number of bytes that follow; then console input
+        if (index == 0) {
+            size_t avail = circular_buffer_available(rx_buffer);
+            data = avail > 0xFF ? 0xFF : avail;
+        } else if (circular_buffer_pop(rx_buffer, &data)) {
+            stats.rx_bytes++;
+        }
+    } else if (reg == REG_TIME_SYNC_DEVICE) {
+        if (index < 8) {
+            data = (sync_device_us >> (8 * index)) & 0xFF;
+        }
+    } else if (is_data_register(reg)) {
+        if (!circular_buffer_pop(rx_buffer, &data)) {
+            data = 0x00;
+        } else {
+            stats.rx_bytes++;
+        }
+    }
+
+    return data;
+}
+
+bool i2c_slave_reg_read_consumes(uint8_t reg) {
+    return is_data_register(reg) || reg == REG_LOOPBACK || reg == REG_LOOPBACK_TS ||
+           reg == REG_URGENT || reg == REG_PRBS_SOURCE || reg == REG_RX_LONGPOLL;
+}
+
+size_t i2c_slave_reg_preview(uint8_t reg, uint8_t *buf, size_t len) {
+    if (is_data_register(reg) || reg == REG_LOOPBACK) {
+        return circular_buffer_peek(is_data_register(reg) ? rx_buffer : &loopback_buffer, buf, len);
+    } else if (reg == REG_URGENT) {
+        return circular_buffer_peek(&urgent_buffer, buf, len);
+    } else if (reg == REG_LOOPBACK_TS) {
+        size_t n = circular_buffer_peek(&loopback_buffer, buf, len);
+        for (uint8_t i = loopback_ts_index; i < 4 && n < len; i++) {
+            buf[n++] = (loopback_timestamp >> (8 * i)) & 0xFF;
+        }
+        return n;
+    } else if (reg == REG_RX_LONGPOLL) {
+        if (len == 0) return 0;
+        size_t avail = circular_buffer_available(rx_buffer);
+        buf[0] = avail > 0xFF ? 0xFF : avail;
+        size_t max = len - 1 < buf[0] ? len - 1 : buf[0];
+        return 1 + circular_buffer_peek(rx_buffer, &buf[1], max);
+    } else if (reg == REG_PRBS_SOURCE) {
+        prbs_source_preview(buf, len);
+        return len;
+    }
+
+    // No side effects: an ordinary read is its own preview
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = i2c_slave_reg_read(reg, i > 0xFF ? 0xFF : (uint8_t)i);
+    }
+    return len;
+}
+
+void i2c_slave_reg_commit(uint8_t reg, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        (void)i2c_slave_reg_read(reg, i > 0xFF ? 0xFF : (uint8_t)i);
+    }
+}
+
+// Answers a stretched long-poll read. Caller must hold off the I2C IRQ.
+static void longpoll_release(bool timed_out) {
+    if (!longpoll_pending) return;
+    longpoll_pending = false;
+
+    if (timed_out) {
+        stats.longpoll_timeouts++;
+    } else {
+        stats.longpoll_hits++;
+        if (longpoll_alarm > 0) cancel_alarm(longpoll_alarm);
+    }
+    longpoll_alarm = 0;
+
+    uint8_t data = i2c_slave_reg_read(REG_RX_LONGPOLL, 0);
+    read_index = 1;
+    i2c_get_hw(i2c0)->data_cmd = data;
+}
+
+static int64_t longpoll_timeout_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    // Timer IRQ has the same priority as the I2C IRQ, so they never nest
+    longpoll_release(true);
+    return 0;
+}
+
+// Back to the idle state between transactions
+static void reset_parser(void) {
+    console_written = false;
+    transaction_started = false;
+    txn_current.flags = 0;
+    write_index = 0;
+    read_index = 0;
+    if (ctrl_flags & CTRL_STICKY) {
+        // Next transaction streams data without a register byte
+        current_register = REG_DATA_START;
+        register_set = true;
+    } else {
+        register_set = false;
+    }
+}
+
+static void txn_begin(void) {
+    // An abort flagged earlier in the same ISR pass belongs to this one
+    uint8_t errors = txn_current.flags & I2C_TXN_ABORT;
+    txn_current = (i2c_txn_t){0};
+    txn_current.flags = errors;
+    txn_current.start_us = time_us_32();
+}
+
+static void txn_end(void) {
+    txn_current.stop_us = time_us_32();
+    txn_current.reg = current_register;
+    if (txn_head - txn_tail >= I2C_TXN_LOG_SIZE) {
+        stats.txn_dropped++;
+        return;
+    }
+    txn_log[txn_head & (I2C_TXN_LOG_SIZE - 1)] = txn_current;
+    __dmb();
+    txn_head++;
+}
 
 static void i2c0_irq_handler(void) {
     i2c_hw_t *hw = i2c_get_hw(i2c0);
     uint32_t intr_stat = hw->intr_stat;
+    last_activity_us = time_us_32();
+
+    bool error = false;
+    if (intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // The source is cleared together with the interrupt. A flush of
+        // stale TX FIFO bytes on the next read request is housekeeping, not
+        // a bus error; the early NACK was already flagged via RX_DONE.
+        uint32_t source = hw->tx_abrt_source;
+        hw->clr_tx_abrt;
+        if (source & ~I2C_IC_TX_ABRT_SOURCE_ABRT_SLVFLUSH_TXFIFO_BITS) error = true;
+    }
+    if (intr_stat & I2C_IC_INTR_STAT_R_RX_OVER_BITS) {
+        hw->clr_rx_over;
+        error = true;
+    }
+    if (error) {
+        stats.i2c_errors++;
+        txn_current.flags |= I2C_TXN_ABORT;
+    }
     
     if (intr_stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
         uint8_t data = (uint8_t)hw->data_cmd;
+        bool first_byte = !transaction_started;
+        if (first_byte) txn_begin();
+        transaction_started = true;
         
-        if (!register_set) {
+        if (first_byte && (ctrl_flags & CTRL_STICKY) && data == REG_ESCAPE) {
+            // Escape out of the data stream: next byte selects a register
+            register_set = false;
+        } else if (!register_set) {
             current_register = data;
             register_set = true;
+            write_index = 0;
+            read_index = 0;
         } else {
-            if (current_register == REG_I2C_ADDRESS) {
-                flash_config_set_i2c_address(data);
-            } else if (current_register == REG_CLOCK_STRETCH) {
-                flash_config_set_clock_stretch(data & 0x01);
-            } else if (current_register >= REG_DATA_START) {
-                if (!circular_buffer_push(tx_buffer, data)) {
-                    stats.tx_overflow++;
-                } else {
-                    stats.tx_bytes++;
-                }
-            }
+            i2c_slave_reg_write(current_register, write_index, data);
+            if (write_index < 0xFF) write_index++;
+            txn_current.write_len++;
+            txn_current.flags |= I2C_TXN_WRITE;
         }
     }
     
     if (intr_stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
         hw->clr_rd_req;
-        uint8_t data = 0;
-        
-        if (current_register == REG_DEVICE_ID) {
-            // Return device ID as 2-byte sequence from single register
-            static uint8_t device_id_byte = 0;
-            if (device_id_byte == 0) {
-                data = (DEVICE_ID >> 8) & 0xFF; // High byte first
-                device_id_byte = 1;
-            } else {
-                data = DEVICE_ID & 0xFF; // Low byte second
-                device_id_byte = 0; // Reset for next read sequence
-            }
-        } else if (current_register == REG_FW_VERSION) {
-            data = fw_version_byte;
-        } else if (current_register >= 0x04 && current_register < 0x04 + sizeof(version_short)) {
-            // Version string registers 0x04-0x13
-            data = version_short[current_register - 0x04];
-        } else if (current_register == REG_I2C_ADDRESS) {
-            data = flash_config_get_i2c_address();
-        } else if (current_register == REG_CLOCK_STRETCH) {
-            data = flash_config_get_clock_stretch() ? 1 : 0;
-        } else if (current_register == REG_TX_AVAIL_LOW) {
-            uint16_t avail = circular_buffer_available(tx_buffer);
-            data = avail & 0xFF;
-        } else if (current_register == REG_TX_AVAIL_HIGH) {
-            uint16_t avail = circular_buffer_available(tx_buffer);
-            data = (avail >> 8) & 0xFF;
-        } else if (current_register == REG_RX_AVAIL) {
-            data = circular_buffer_available(rx_buffer) & 0xFF;
-        } else if (current_register >= REG_DATA_START) {
-            if (!circular_buffer_pop(rx_buffer, &data)) {
-                data = 0x00;
-            } else {
-                stats.rx_bytes++;
-            }
+        if (!transaction_started) txn_begin();
+        transaction_started = true;
+        txn_current.read_len++;
+        txn_current.flags |= I2C_TXN_READ;
+        if (current_register == REG_RX_LONGPOLL && read_index == 0 &&
+            circular_buffer_available(rx_buffer) == 0) {
+            // Hold SCL low until i2c_slave_task() or the alarm answers
+            longpoll_pending = true;
+            longpoll_alarm = add_alarm_in_us((uint64_t)longpoll_timeout_ms * 1000,
+                                             longpoll_timeout_cb, NULL, true);
+            // Without a timeout (alarm pool full) the stretch could last
+            // forever, and the hang watchdog skips pending long-polls:
+            // answer right away instead
+            if (longpoll_alarm <= 0) longpoll_release(true);
+        } else {
+            uint8_t data = i2c_slave_reg_read(current_register, read_index);
+            if (read_index < 0xFF) read_index++;
+            hw->data_cmd = data;
         }
-        
-        hw->data_cmd = data;
     }
     
+    if (intr_stat & I2C_IC_INTR_STAT_R_RX_DONE_BITS) {
+        // The master NACKed a read byte. That ends every read; it only
+        // matters if bytes were still waiting in the TX FIFO.
+        hw->clr_rx_done;
+        if (hw->txflr > 0) txn_current.flags |= I2C_TXN_NACK;
+    }
+
     if (intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
         hw->clr_stop_det;
-        register_set = false;
+        if (txn_current.flags & I2C_TXN_ABORT) {
+            if (++error_streak >= I2C_ERROR_STREAK_LIMIT) recover_requested = true;
+        } else {
+            error_streak = 0;
+        }
+        if (transaction_started) txn_end();
+        if (console_written && (ctrl_flags & CTRL_FLUSH_ON_STOP)) {
+            flush_requested = true;
+            stats.flush_requests++;
+        }
+        reset_parser();
+    }
+}
+
+static void configure_controller(void) {
+    i2c_init(i2c0, 100000);
+    
+    i2c_hw_t *hw = i2c_get_hw(i2c0);
+    hw->enable = 0;
+    hw->con = I2C_IC_CON_IC_SLAVE_DISABLE_BITS | I2C_IC_CON_IC_RESTART_EN_BITS;
+    hw->sar = flash_config_get_i2c_address();
+    hw->con &= ~I2C_IC_CON_IC_SLAVE_DISABLE_BITS;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | 
+                    I2C_IC_INTR_MASK_M_RD_REQ_BITS |
+                    I2C_IC_INTR_MASK_M_RX_DONE_BITS |
+                    I2C_IC_INTR_MASK_M_STOP_DET_BITS |
+                    I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
+                    I2C_IC_INTR_MASK_M_RX_OVER_BITS;
+    hw->enable = 1;
+}
+
+// Resets the controller (releasing any line it holds) and the parser.
+// i2c_init() pulses the block reset, so a half-shifted byte is discarded.
+static void recover(const char *reason) {
+    irq_set_enabled(I2C0_IRQ, false);
+
+    if (longpoll_pending) {
+        longpoll_pending = false;
+        if (longpoll_alarm > 0) cancel_alarm(longpoll_alarm);
+        longpoll_alarm = 0;
     }
+    configure_controller();
+    reset_parser();
+    error_streak = 0;
+    recover_requested = false;
+    last_activity_us = time_us_32();
+    stats.recoveries++;
+
+    irq_clear(I2C0_IRQ);
+    irq_set_enabled(I2C0_IRQ, true);
+
+    LOG_WARN("I2C slave recovered: %s", reason);
+    usb_stream_event(STREAM_EVT_I2C_RECOVERY, stats.recoveries);
 }
 
 void i2c_slave_init(circular_buffer_t *tx_buf, circular_buffer_t *rx_buf) {
     tx_buffer = tx_buf;
     rx_buffer = rx_buf;
+    circular_buffer_init(&urgent_buffer, urgent_data, URGENT_BUFFER_SIZE);
+    circular_buffer_init(&loopback_buffer, loopback_data, LOOPBACK_BUFFER_SIZE);
+    ram_budget_add("I2C slave txn log", sizeof(txn_log));
+    ram_budget_add("I2C slave aux rings", sizeof(loopback_data) + sizeof(urgent_data));
+    channel_buffers[I2C_CHANNEL_CONSOLE] = tx_buf;
     
     parse_version();
     
@@ -121,26 +550,116 @@ void i2c_slave_init(circular_buffer_t *tx_buf, circular_buffer_t *rx_buf) {
     gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SLAVE_SCL_PIN);
     
-    i2c_init(i2c0, 100000);
-    
-    i2c_hw_t *hw = i2c_get_hw(i2c0);
-    hw->enable = 0;
-    hw->con = I2C_IC_CON_IC_SLAVE_DISABLE_BITS | I2C_IC_CON_IC_RESTART_EN_BITS;
-    hw->sar = flash_config_get_i2c_address();
-    hw->con &= ~I2C_IC_CON_IC_SLAVE_DISABLE_BITS;
-    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | 
-                    I2C_IC_INTR_MASK_M_RD_REQ_BITS |
-                    I2C_IC_INTR_MASK_M_STOP_DET_BITS;
-    hw->enable = 1;
+    configure_controller();
     
     irq_set_exclusive_handler(I2C0_IRQ, i2c0_irq_handler);
+    irq_set_priority(I2C0_IRQ, I2C_SLAVE_IRQ_PRIORITY);
     irq_set_enabled(I2C0_IRQ, true);
 }
 
 void i2c_slave_task(void) {
-    // Handler runs in interrupt context
+    // Register handling runs in interrupt context. From here, long-poll
+    // reads are completed as soon as console input has arrived (an urgent
+    // byte also ends the wait; the master finds it via REG_STATUS).
+    if (longpoll_pending && (circular_buffer_available(rx_buffer) > 0 ||
+                             circular_buffer_available(&urgent_buffer) > 0)) {
+        uint32_t ints = save_and_disable_interrupts();
+        longpoll_release(false);
+        restore_interrupts(ints);
+    }
+
+    // Hang watchdog. A pending long-poll stretches SCL on purpose and has
+    // its own timeout, so it is left alone.
+    if (longpoll_pending) {
+        bus_low = false;
+        return;
+    }
+
+    if (recover_requested) {
+        recover("repeated TX_ABRT/RX_OVER");
+        return;
+    }
+
+    // Snapshot the ISR's timestamp before reading the clock, so an update
+    // in between can't make idle wrap to a huge value
+    uint32_t last = last_activity_us;
+    uint32_t now = time_us_32();
+    uint32_t idle = now - last;
+
+    if (transaction_started && idle > I2C_HANG_TIMEOUT_US) {
+        recover("missing STOP");
+        return;
+    }
+
+    if (!gpio_get(I2C_SLAVE_SDA_PIN) || !gpio_get(I2C_SLAVE_SCL_PIN)) {
+        // A single late sample could land on two unrelated low phases; only
+        // a line seen low at evenly spaced points across the window is stuck
+        if (!bus_low) {
+            bus_low = true;
+            bus_low_since_us = now;
+            bus_low_sample_us = now;
+            bus_low_samples = 1;
+        } else if (now - bus_low_sample_us >= I2C_HANG_TIMEOUT_US / I2C_HANG_LOW_SAMPLES) {
+            bus_low_sample_us = now;
+            if (bus_low_samples < I2C_HANG_LOW_SAMPLES) bus_low_samples++;
+        }
+        if (!bus_low_handled && bus_low_samples >= I2C_HANG_LOW_SAMPLES &&
+            now - bus_low_since_us > I2C_HANG_TIMEOUT_US &&
+            idle > I2C_HANG_TIMEOUT_US) {
+            // If the line is held by someone else a reset won't help;
+            // don't retry until it has been released once
+            bus_low_handled = true;
+            recover("SDA/SCL stuck low");
+        }
+    } else {
+        bus_low = false;
+        bus_low_handled = false;
+    }
 }
 
 i2c_stats_t i2c_slave_get_stats(void) {
     return stats;
 }
+
+void i2c_slave_reset_stats(void) {
+    uint32_t ints = save_and_disable_interrupts();
+    stats = (i2c_stats_t){0};
+    restore_interrupts(ints);
+}
+
+void i2c_slave_set_channel_buffer(uint8_t channel, circular_buffer_t *buf) {
+    if (channel < I2C_CHANNEL_COUNT) {
+        channel_buffers[channel] = buf;
+    }
+}
+
+void i2c_slave_set_console_mirror(circular_buffer_t *buf) {
+    console_mirror = buf;
+}
+
+bool i2c_slave_take_flush_request(void) {
+    if (!flush_requested) return false;
+    flush_requested = false;
+    return true;
+}
+
+bool i2c_slave_is_urgent(uint8_t byte) {
+    return urgent_set[byte >> 3] & (1u << (byte & 7));
+}
+
+void i2c_slave_push_urgent(uint8_t byte) {
+    circular_buffer_push(&urgent_buffer, byte);
+    stats.urgent_bytes++;
+}
+
+bool i2c_slave_txn_pop(i2c_txn_t *txn) {
+    if (txn_tail == txn_head) return false;
+    __dmb();
+    *txn = txn_log[txn_tail & (I2C_TXN_LOG_SIZE - 1)];
+    txn_tail++;
+    return true;
+}
+
+bool i2c_slave_is_data_register(uint8_t reg) {
+    return is_data_register(reg);
+}
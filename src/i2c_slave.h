@@ -2,11 +2,17 @@
 #define I2C_SLAVE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "circular_buffer.h"
 
 #define I2C_SLAVE_SDA_PIN 28
 #define I2C_SLAVE_SCL_PIN 29
 
+// NVIC priority of every interrupt that touches the register map (I2C,
+// SPI chip select, long-poll alarm), so they never nest. Equal to
+// PICO_DEFAULT_IRQ_PRIORITY, which the alarm pool's timer IRQ uses.
+#define I2C_SLAVE_IRQ_PRIORITY 0x80
+
 #define REG_DEVICE_ID 0x00
 #define REG_FW_VERSION 0x01
 #define REG_I2C_ADDRESS 0x02
@@ -15,19 +21,118 @@
 #define REG_TX_AVAIL_HIGH 0x11
 #define REG_RX_AVAIL 0x12
 #define REG_DATA_START 0x20
+#define REG_DATA_END 0x7F
+#define REG_LOOPBACK 0x80
+#define REG_LOOPBACK_TS 0x81
+#define REG_TIME_SYNC_MASTER 0x82
+#define REG_TIME_SYNC_DEVICE 0x83
+#define REG_CHANNEL_DATA 0x84
+#define REG_FLUSH 0x85
+#define REG_CTRL 0x86
+#define REG_RX_LONGPOLL 0x87
+#define REG_LONGPOLL_TIMEOUT 0x88
+#define REG_STATUS 0x89
+#define REG_URGENT 0x8A
+#define REG_PRBS_SOURCE 0x8B
+#define REG_PRBS_SINK 0x8C
+#define REG_PRBS_STATS 0x8D
+// Sticky mode only: first byte of a write selects a register again
+#define REG_ESCAPE 0xFF
+
+// REG_CTRL bits (not persisted)
+#define CTRL_FLUSH_ON_STOP 0x01
+#define CTRL_STICKY        0x02  // writes start with data, no register byte
+
+#define LONGPOLL_DEFAULT_TIMEOUT_MS 50
+
+// REG_STATUS bits
+#define STATUS_URGENT  0x01  // urgent bytes pending in REG_URGENT
+#define STATUS_RX_DATA 0x02  // console input pending
+#define STATUS_TX_DATA 0x04  // console output not yet sent to USB
+
+#define URGENT_BUFFER_SIZE 16
+
+// Bus-hang watchdog: no ISR activity for this long while a transaction is
+// open, or SDA/SCL held low, resets the controller. Above the 35 ms SMBus
+// clock-low timeout, so a slow but legal master is left alone.
+#define I2C_HANG_TIMEOUT_US 35000
+// Spaced low samples needed across that window before a line counts as stuck
+#define I2C_HANG_LOW_SAMPLES 8
+// Consecutive transactions with TX_ABRT/RX_OVER before a reset
+#define I2C_ERROR_STREAK_LIMIT 4
+
+// Per-transaction metadata ring (power of two)
+#define I2C_TXN_LOG_SIZE 64
+
+#define I2C_TXN_WRITE 0x01  // master wrote data bytes
+#define I2C_TXN_READ  0x02  // master read data bytes
+#define I2C_TXN_ABORT 0x04  // TX abort or RX overrun during the transaction
+#define I2C_TXN_NACK  0x08  // master NACKed a read byte while the TX FIFO still held data
+
+typedef struct {
+    uint32_t start_us;   // first byte or read request
+    uint32_t stop_us;    // STOP detected
+    uint16_t write_len;  // data bytes written (excluding the register byte)
+    uint16_t read_len;
+    uint8_t reg;
+    uint8_t flags;
+} i2c_txn_t;
+
+#define LOOPBACK_BUFFER_SIZE 64
 
 #define DEVICE_ID 0x12C0
 
+// Logical channels for REG_CHANNEL_DATA frames: [channel][len][payload]...
+#define I2C_CHANNEL_CONSOLE   0
+#define I2C_CHANNEL_TELEMETRY 1
+#define I2C_CHANNEL_COUNT     2
+
 typedef struct {
     uint32_t tx_bytes;
     uint32_t rx_bytes;
     uint32_t tx_overflow;
     uint32_t rx_overflow;
     uint32_t i2c_errors;
+    uint32_t channel_bytes[I2C_CHANNEL_COUNT];
+    uint32_t channel_overflow[I2C_CHANNEL_COUNT];
+    uint32_t frame_errors;
+    uint32_t flush_requests;
+    uint32_t longpoll_hits;      // released early by incoming data
+    uint32_t longpoll_timeouts;
+    uint32_t urgent_bytes;
+    uint32_t txn_dropped;        // metadata ring full
+    uint32_t recoveries;         // controller resets by the hang watchdog
 } i2c_stats_t;
 
 void i2c_slave_init(circular_buffer_t *tx_buf, circular_buffer_t *rx_buf);
 void i2c_slave_task(void);
 i2c_stats_t i2c_slave_get_stats(void);
+void i2c_slave_reset_stats(void);
+void i2c_slave_set_channel_buffer(uint8_t channel, circular_buffer_t *buf);
+// Every console byte written by the master is also pushed here (drop-oldest)
+void i2c_slave_set_console_mirror(circular_buffer_t *buf);
+bool i2c_slave_take_flush_request(void);
+
+// Urgent bytes (e.g. Ctrl-C) bypass the RX buffer; the set is empty by
+// default and configured by the master through REG_URGENT
+bool i2c_slave_is_urgent(uint8_t byte);
+void i2c_slave_push_urgent(uint8_t byte);
+
+// Transaction metadata, consumed from the main loop
+bool i2c_slave_txn_pop(i2c_txn_t *txn);
+
+// Register file access for other transports (e.g. SPI slave)
+void i2c_slave_reg_write(uint8_t reg, uint8_t index, uint8_t data);
+uint8_t i2c_slave_reg_read(uint8_t reg, uint8_t index);
+// Registers whose reads pop a ring or advance a generator
+bool i2c_slave_reg_read_consumes(uint8_t reg);
+// Fills buf with what up to len reads of reg from index 0 would return,
+// without their side effects. For consuming registers only the bytes
+// actually pending are returned. Call with the I2C IRQ held off.
+size_t i2c_slave_reg_preview(uint8_t reg, uint8_t *buf, size_t len);
+// Performs n reads of reg from index 0 and discards the data, applying
+// their side effects (pops, counters) after a preview was delivered
+void i2c_slave_reg_commit(uint8_t reg, size_t n);
+bool i2c_slave_is_data_register(uint8_t reg);
 
 #endif
@@ -0,0 +1,238 @@
+#include "i2c_sniffer.h"
+#include "i2c_sniffer.pio.h"
+#include "i2c_slave.h"
+#include "circular_buffer.h"
+#include "usb_cdc.h"
+#include "log.h"
+#include "ram_budget.h"
+#include "tusb.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+#define SNIFFER_PIO pio0
+#define SNIFFER_IRQ PIO0_IRQ_0
+
+#define EVT_BIT0  0
+#define EVT_BIT1  1
+#define EVT_START 2
+#define EVT_STOP  3
+
+static uint sm;
+static uint offset;
+static uint8_t stream_data[SNIFFER_BUFFER_SIZE];
+static circular_buffer_t stream;
+static sniffer_stats_t stats = {0};
+static uint32_t filter[4];  // one bit per 7-bit address
+
+// Decoder state, owned by the PIO IRQ
+static bool in_transaction = false;
+static bool expect_address = false;
+static bool repeated_start = false;
+static bool pass = false;
+static uint32_t start_us = 0;
+static uint8_t bit_count = 0;
+static uint8_t shift = 0;
+
+static inline bool filter_allows(uint8_t address) {
+    return filter[address >> 5] & (1u << (address & 31));
+}
+
+static void emit(const uint8_t *rec, size_t len) {
+    if (circular_buffer_free(&stream) < len) {
+        stats.dropped++;
+        return;
+    }
+    circular_buffer_write(&stream, rec, len);
+}
+
+static void emit_timestamp(uint8_t tag, uint32_t us) {
+    uint8_t rec[5] = {tag, us & 0xFF, (us >> 8) & 0xFF, (us >> 16) & 0xFF, (us >> 24) & 0xFF};
+    emit(rec, sizeof(rec));
+}
+
+static void decode_byte(uint8_t value, bool ack) {
+    if (expect_address) {
+        expect_address = false;
+        pass = filter_allows(value >> 1);
+        if (!pass) {
+            stats.filtered++;
+            return;
+        }
+        stats.transactions++;
+        // START is held back until the address passed the filter
+        uint8_t rec[7] = {
+            repeated_start ? SNIFF_REC_RESTART : SNIFF_REC_START,
+            start_us & 0xFF, (start_us >> 8) & 0xFF, (start_us >> 16) & 0xFF, (start_us >> 24) & 0xFF,
+            ack ? SNIFF_REC_ADDR_ACK : SNIFF_REC_ADDR_NACK, value
+        };
+        emit(rec, sizeof(rec));
+    } else if (pass) {
+        uint8_t rec[2] = {ack ? SNIFF_REC_DATA_ACK : SNIFF_REC_DATA_NACK, value};
+        emit(rec, sizeof(rec));
+    }
+}
+
+static void decode_event(uint32_t evt) {
+    switch (evt) {
+    case EVT_START:
+        repeated_start = in_transaction && pass;
+        in_transaction = true;
+        expect_address = true;
+        start_us = time_us_32();
+        bit_count = 0;
+        break;
+    case EVT_STOP:
+        if (in_transaction && pass) {
+            emit_timestamp(SNIFF_REC_STOP, time_us_32());
+        }
+        in_transaction = false;
+        pass = false;
+        bit_count = 0;
+        break;
+    default:
+        if (!in_transaction) break;
+        if (bit_count < 8) {
+            shift = (shift << 1) | (evt & 1);
+            bit_count++;
+        } else {
+            // 9th bit: SDA low means ACK
+            decode_byte(shift, evt == EVT_BIT0);
+            bit_count = 0;
+        }
+        break;
+    }
+}
+
+static void sniffer_irq_handler(void) {
+    // push noblock drops events when the FIFO is full and flags RXSTALL.
+    // A lost bit shifts every following byte, so stop decoding until the
+    // next START re-aligns the decoder.
+    uint32_t stall = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm);
+    if (SNIFFER_PIO->fdebug & stall) {
+        SNIFFER_PIO->fdebug = stall;
+        stats.overflows++;
+        in_transaction = false;
+        pass = false;
+        bit_count = 0;
+    }
+
+    while (!pio_sm_is_rx_fifo_empty(SNIFFER_PIO, sm)) {
+        decode_event(pio_sm_get(SNIFFER_PIO, sm));
+    }
+}
+
+void sniffer_init(void) {
+    circular_buffer_init(&stream, stream_data, SNIFFER_BUFFER_SIZE);
+    ram_budget_add("Sniffer ring", sizeof(stream_data));
+    sniffer_filter_pass_all();
+
+    // Sample the slave's own bus pins without changing their function
+    offset = pio_add_program(SNIFFER_PIO, &i2c_sniffer_program);
+    sm = pio_claim_unused_sm(SNIFFER_PIO, true);
+
+    pio_sm_config c = i2c_sniffer_program_get_default_config(offset);
+    sm_config_set_in_pins(&c, I2C_SLAVE_SDA_PIN);
+    sm_config_set_in_pin_count(&c, 1);
+    sm_config_set_jmp_pin(&c, I2C_SLAVE_SCL_PIN);
+    sm_config_set_in_shift(&c, false, false, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    pio_sm_init(SNIFFER_PIO, sm, offset, &c);
+
+    pio_set_irq0_source_enabled(SNIFFER_PIO, pio_get_rx_fifo_not_empty_interrupt_source(sm), true);
+    irq_set_exclusive_handler(SNIFFER_IRQ, sniffer_irq_handler);
+}
+
+void sniffer_set_enabled(bool enable) {
+    if (enable == stats.enabled) return;
+
+    if (enable) {
+        in_transaction = false;
+        pass = false;
+        bit_count = 0;
+        pio_sm_clear_fifos(SNIFFER_PIO, sm);
+        pio_sm_restart(SNIFFER_PIO, sm);
+        // Restart leaves the PC alone; start over at the top of the program
+        pio_sm_exec(SNIFFER_PIO, sm, pio_encode_jmp(offset));
+        SNIFFER_PIO->fdebug = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm);
+        irq_set_enabled(SNIFFER_IRQ, true);
+        pio_sm_set_enabled(SNIFFER_PIO, sm, true);
+    } else {
+        pio_sm_set_enabled(SNIFFER_PIO, sm, false);
+        irq_set_enabled(SNIFFER_IRQ, false);
+    }
+    stats.enabled = enable;
+    LOG_INFO("I2C sniffer %s", enable ? "enabled" : "disabled");
+}
+
+void sniffer_filter_pass_all(void) {
+    memset(filter, 0xFF, sizeof(filter));
+}
+
+void sniffer_filter_clear(void) {
+    memset(filter, 0, sizeof(filter));
+}
+
+void sniffer_filter_allow(uint8_t address) {
+    address &= 0x7F;
+    filter[address >> 5] |= 1u << (address & 31);
+}
+
+static void sniffer_handle_commands(void) {
+    static bool expect_address_arg = false;
+    uint8_t buf[16];
+
+    uint32_t len = tud_cdc_n_read(CDC_ITF_SNIFFER, buf, sizeof(buf));
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t c = buf[i];
+        if (expect_address_arg) {
+            sniffer_filter_allow(c);
+            expect_address_arg = false;
+        } else if (c == SNIFF_CMD_ENABLE) {
+            sniffer_set_enabled(true);
+        } else if (c == SNIFF_CMD_DISABLE) {
+            sniffer_set_enabled(false);
+        } else if (c == SNIFF_CMD_PASS_ALL) {
+            sniffer_filter_pass_all();
+        } else if (c == SNIFF_CMD_CLEAR) {
+            sniffer_filter_clear();
+        } else if (c == SNIFF_CMD_ALLOW) {
+            expect_address_arg = true;
+        }
+    }
+}
+
+void sniffer_task(void) {
+    if (tud_cdc_n_available(CDC_ITF_SNIFFER)) {
+        sniffer_handle_commands();
+    }
+
+    // Stop decoding when nobody is listening
+    if (stats.enabled && !tud_cdc_n_connected(CDC_ITF_SNIFFER)) {
+        sniffer_set_enabled(false);
+    }
+    if (!stats.enabled) return;
+
+    uint8_t buf[64];
+    uint32_t space;
+    bool wrote = false;
+    while ((space = tud_cdc_n_write_available(CDC_ITF_SNIFFER)) > 0) {
+        if (space > sizeof(buf)) space = sizeof(buf);
+
+        uint32_t ints = save_and_disable_interrupts();
+        size_t len = circular_buffer_read(&stream, buf, space);
+        restore_interrupts(ints);
+
+        if (len == 0) break;
+        tud_cdc_n_write(CDC_ITF_SNIFFER, buf, len);
+        wrote = true;
+    }
+    if (wrote) {
+        tud_cdc_n_write_flush(CDC_ITF_SNIFFER);
+    }
+}
+
+sniffer_stats_t sniffer_get_stats(void) {
+    return stats;
+}
@@ -0,0 +1,41 @@
+#ifndef I2C_SNIFFER_H
+#define I2C_SNIFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SNIFFER_BUFFER_SIZE 8192
+
+// Stream record tags (host-bound, on CDC_ITF_SNIFFER)
+#define SNIFF_REC_START     0x01  // + u32 timestamp (µs, LE)
+#define SNIFF_REC_RESTART   0x02  // + u32 timestamp
+#define SNIFF_REC_STOP      0x03  // + u32 timestamp
+#define SNIFF_REC_ADDR_ACK  0x10  // + (addr << 1 | R/W)
+#define SNIFF_REC_ADDR_NACK 0x11
+#define SNIFF_REC_DATA_ACK  0x20  // + data byte
+#define SNIFF_REC_DATA_NACK 0x21
+
+// Control bytes (device-bound, on CDC_ITF_SNIFFER)
+#define SNIFF_CMD_ENABLE    'E'
+#define SNIFF_CMD_DISABLE   'D'
+#define SNIFF_CMD_PASS_ALL  'P'   // no address filter
+#define SNIFF_CMD_CLEAR     'C'   // filter out all addresses
+#define SNIFF_CMD_ALLOW     'A'   // + address: let it through the filter
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t filtered;      // transactions suppressed by the address filter
+    uint32_t dropped;       // records lost because the stream buffer was full
+    uint32_t overflows;     // PIO RX FIFO overflows; decoding resumes at the next START
+    bool enabled;
+} sniffer_stats_t;
+
+void sniffer_init(void);
+void sniffer_task(void);
+void sniffer_set_enabled(bool enable);
+void sniffer_filter_pass_all(void);
+void sniffer_filter_clear(void);
+void sniffer_filter_allow(uint8_t address);
+sniffer_stats_t sniffer_get_stats(void);
+
+#endif
@@ -16,9 +16,9 @@ static void draw_labels_i2c(void) {
     lcd_draw_string(5, 110, "Err:", COLOR_WHITE, COLOR_BLACK);
 }
 
-static void draw_labels_uart(void) {
+static void draw_labels_uart(uint8_t channel) {
     lcd_clear(COLOR_BLACK);
-    lcd_draw_string(66, 5, "UART Bridge", COLOR_YELLOW, COLOR_BLACK);
+    lcd_draw_string(66, 5, uart_bridge_channel_name(channel), COLOR_YELLOW, COLOR_BLACK);
     lcd_draw_string(5, 30, "Baud:", COLOR_WHITE, COLOR_BLACK);
     lcd_draw_string(5, 50, "Fmt:", COLOR_WHITE, COLOR_BLACK);
     lcd_draw_string(5, 70, "TX:", COLOR_WHITE, COLOR_BLACK);
@@ -37,7 +37,7 @@ void lcd_ui_switch_screen(void) {
     if (current_screen == LCD_SCREEN_I2C) {
         draw_labels_i2c();
     } else {
-        draw_labels_uart();
+        draw_labels_uart(current_screen - LCD_SCREEN_UART);
     }
 }
 
@@ -62,8 +62,8 @@ void lcd_ui_update_i2c(uint8_t i2c_addr, uint16_t tx_avail, uint16_t rx_avail,
     lcd_draw_string(70, 110, buf, errors > 0 ? COLOR_RED : COLOR_GREEN, COLOR_BLACK);
 }
 
-void lcd_ui_update_uart(uart_bridge_stats_t *stats) {
-    if (current_screen != LCD_SCREEN_UART) return;
+void lcd_ui_update_uart(uint8_t channel, uart_bridge_stats_t *stats) {
+    if (current_screen != (lcd_screen_t)(LCD_SCREEN_UART + channel)) return;
 
     snprintf(buf, sizeof(buf), "%lu   ", (unsigned long)stats->baud_rate);
     lcd_draw_string(70, 30, buf, COLOR_GREEN, COLOR_BLACK);
@@ -71,7 +71,8 @@ void lcd_ui_update_uart(uart_bridge_stats_t *stats) {
     const char *par = "N";
     if (stats->parity == 1) par = "O";
     else if (stats->parity == 2) par = "E";
-    snprintf(buf, sizeof(buf), "%u%s%u ", stats->data_bits, par, stats->stop_bits);
+    snprintf(buf, sizeof(buf), "%u%s%u %s", stats->data_bits, par, stats->stop_bits,
+             stats->pio_backend ? "PIO" : "   ");
     lcd_draw_string(60, 50, buf, COLOR_GREEN, COLOR_BLACK);
 
     snprintf(buf, sizeof(buf), "%lu   ", (unsigned long)stats->tx_bytes);
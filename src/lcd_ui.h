@@ -3,13 +3,13 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "usb_cdc.h"
+#include "uart_bridge.h"
 #include "i2c_slave.h"
 
 typedef enum {
     LCD_SCREEN_I2C = 0,
-    LCD_SCREEN_UART,
-    LCD_SCREEN_COUNT
+    LCD_SCREEN_UART,  // one screen per bridge channel from here on
+    LCD_SCREEN_COUNT = LCD_SCREEN_UART + UART_BRIDGE_CHANNELS
 } lcd_screen_t;
 
 void lcd_ui_init(void);
@@ -17,6 +17,6 @@ void lcd_ui_switch_screen(void);
 void lcd_ui_update_i2c(uint8_t i2c_addr, uint16_t tx_avail, uint16_t rx_avail,
                        uint32_t tx_bytes, uint32_t rx_bytes, bool usb_connected,
                        uint32_t errors);
-void lcd_ui_update_uart(uart_bridge_stats_t *stats);
+void lcd_ui_update_uart(uint8_t channel, uart_bridge_stats_t *stats);
 
 #endif
@@ -1,6 +1,7 @@
 #include "log.h"
 #include "tusb.h"
 #include "pico/stdlib.h"
+#include "time_sync.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -10,6 +11,7 @@
 
 static log_level_t current_level = LOG_INFO;
 static char log_buffer[LOG_BUFFER_SIZE];
+static circular_buffer_t *capture = NULL;
 
 static const char *level_strings[] = {
     "DEBUG",
@@ -26,13 +28,29 @@ void log_set_level(log_level_t level) {
     current_level = level;
 }
 
+void log_set_capture(circular_buffer_t *buf) {
+    capture = buf;
+}
+
 void log_printf(log_level_t level, const char *fmt, ...) {
     if (level < current_level) return;
-    if (!tud_cdc_n_connected(LOG_CDC_ITF)) return;
+    bool connected = tud_cdc_n_connected(LOG_CDC_ITF);
+    if (!connected && !capture) return;
     
-    uint32_t ms = to_ms_since_boot(get_absolute_time());
-    int len = snprintf(log_buffer, LOG_BUFFER_SIZE, "[%6lu.%03lu] %s: ",
-                      ms / 1000, ms % 1000, level_strings[level]);
+    // Device time_us_64() in µs, the base USB SOF pairs map onto host
+    // time; master time (marked M) once time sync is established
+    int len;
+    uint64_t now_us = time_us_64();
+    uint64_t master_us;
+    if (time_sync_to_master(now_us, &master_us)) {
+        len = snprintf(log_buffer, LOG_BUFFER_SIZE, "[M%6lu.%06lu] %s: ",
+                       (unsigned long)(master_us / 1000000), (unsigned long)(master_us % 1000000),
+                       level_strings[level]);
+    } else {
+        len = snprintf(log_buffer, LOG_BUFFER_SIZE, "[%6lu.%06lu] %s: ",
+                       (unsigned long)(now_us / 1000000), (unsigned long)(now_us % 1000000),
+                       level_strings[level]);
+    }
     
     va_list args;
     va_start(args, fmt);
@@ -44,6 +62,14 @@ void log_printf(log_level_t level, const char *fmt, ...) {
     }
     log_buffer[len++] = '\n';
     log_buffer[len] = '\0';
+
+    // Captured lines are kept even while nobody is listening
+    if (capture) {
+        for (int i = 0; i < len; i++) {
+            circular_buffer_push(capture, (uint8_t)log_buffer[i]);
+        }
+    }
+    if (!connected) return;
     
     tud_cdc_n_write(LOG_CDC_ITF, log_buffer, len);
     tud_cdc_n_write_flush(LOG_CDC_ITF);
@@ -2,6 +2,7 @@
 #define LOG_H
 
 #include <stdint.h>
+#include "circular_buffer.h"
 
 typedef enum {
     LOG_DEBUG = 0,
@@ -12,6 +13,8 @@ typedef enum {
 
 void log_init(void);
 void log_set_level(log_level_t level);
+// Every log line at or above the current level is also pushed here
+void log_set_capture(circular_buffer_t *buf);
 void log_printf(log_level_t level, const char *fmt, ...);
 
 #define LOG_DEBUG(...) log_printf(LOG_DEBUG, __VA_ARGS__)
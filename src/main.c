@@ -3,15 +3,40 @@
 #include "hardware/watchdog.h"
 #include "circular_buffer.h"
 #include "i2c_slave.h"
+#include "spi_slave.h"
+#include "i2c_adapter.h"
+#include "usb_stream.h"
 #include "usb_cdc.h"
+#if I2CONSOLE_SNIFFER
+#include "i2c_sniffer.h"
+#endif
+#include "uart_bridge.h"
 #include "flash_config.h"
 #include "lcd_ui.h"
 #include "log.h"
 #include "button.h"
+#include "time_sync.h"
+#include "prbs.h"
+#include "ram_budget.h"
+#include "shell.h"
+#include "usb_bench.h"
+#include "usb_sof.h"
+#if I2CONSOLE_MSC
+#include "history.h"
+#include "usb_msc.h"
+#endif
 #include "version.h"
 
+// Console ring sizes; the USB build profile in CMakeLists.txt may override
+#ifndef TX_BUFFER_SIZE
 #define TX_BUFFER_SIZE 256
+#endif
+#ifndef RX_BUFFER_SIZE
 #define RX_BUFFER_SIZE 1024
+#endif
+#ifndef TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_BUFFER_SIZE 1024
+#endif
 #define WATCHDOG_TIMEOUT_MS 8000
 #define UI_UPDATE_INTERVAL_MS 100
 
@@ -19,6 +44,8 @@ static uint8_t tx_buffer_data[TX_BUFFER_SIZE];
 static uint8_t rx_buffer_data[RX_BUFFER_SIZE];
 static circular_buffer_t tx_buffer;
 static circular_buffer_t rx_buffer;
+static uint8_t telemetry_buffer_data[TELEMETRY_BUFFER_SIZE];
+static circular_buffer_t telemetry_buffer;
 
 int main(void) {
     if (watchdog_caused_reboot()) {
@@ -30,9 +57,21 @@ int main(void) {
 
     circular_buffer_init(&tx_buffer, tx_buffer_data, TX_BUFFER_SIZE);
     circular_buffer_init(&rx_buffer, rx_buffer_data, RX_BUFFER_SIZE);
+    circular_buffer_init(&telemetry_buffer, telemetry_buffer_data, TELEMETRY_BUFFER_SIZE);
+
+    ram_budget_init();
+    ram_budget_add("Console TX ring", TX_BUFFER_SIZE);
+    ram_budget_add("Console RX ring", RX_BUFFER_SIZE);
+    ram_budget_add("Telemetry ring", TELEMETRY_BUFFER_SIZE);
 
     usb_cdc_init();
+    time_sync_init();
     log_init();
+#if I2CONSOLE_MSC
+    // Before the first log line so the boot messages are captured
+    history_init();
+    usb_msc_init();
+#endif
     uart_bridge_init();
     button_init();
 
@@ -46,12 +85,33 @@ int main(void) {
         LOG_WARN("System recovered from watchdog reset");
     }
 
+    prbs_init();
     i2c_slave_init(&tx_buffer, &rx_buffer);
+    i2c_slave_set_channel_buffer(I2C_CHANNEL_TELEMETRY, &telemetry_buffer);
     LOG_INFO("I2C slave initialized on GPIO28/29");
 
+    spi_slave_init();
+    LOG_INFO("SPI slave initialized on GPIO16-19");
+
+#if I2CONSOLE_SNIFFER
+    sniffer_init();
+#endif
+    i2c_adapter_init();
+    usb_stream_init();
+    usb_sof_init();
+
+    shell_init();
+    usb_bench_init();
+    shell_add_ring("tx", &tx_buffer);
+    shell_add_ring("rx", &rx_buffer);
+    shell_add_ring("telemetry", &telemetry_buffer);
+
     lcd_ui_init();
     LOG_INFO("LCD initialized");
-    LOG_INFO("UART bridge on GP4/GP5");
+    for (uint8_t ch = 0; ch < UART_BRIDGE_CHANNELS; ch++) {
+        LOG_INFO("UART bridge %u on %s", ch, uart_bridge_channel_name(ch));
+    }
+    ram_budget_report();
     LOG_INFO("System ready");
 
     uint32_t last_ui_update = 0;
@@ -60,25 +120,81 @@ int main(void) {
         watchdog_update();
 
         usb_cdc_task();
-        usb_cdc_check_bootloader_cmd();
+        shell_task();
+        usb_bench_task();
         uart_bridge_task();
+        time_sync_task();
+#if I2CONSOLE_SNIFFER
+        sniffer_task();
+#endif
+        prbs_task();
+        i2c_adapter_task();
+        usb_stream_task();
+        usb_sof_task();
+        spi_slave_task();
+
+        // I2C TX buffer → USB CDC0 and, while started, the vendor stream.
+        // A running benchmark has CDC0 to itself.
+        bool to_cdc = usb_cdc_connected() && !usb_bench_active();
+        bool to_stream = usb_stream_active();
+        if (to_cdc || to_stream) {
+            // Fill CDC0's space a packet at a time. The stream is an extra
+            // sink, not a gate: a chunk it has no room for is dropped there
+            // (and counted) rather than holding up a healthy CDC0 reader.
+            // Without CDC0 the stream is the only sink and sets the pace.
+            uint8_t buf[USB_CDC_PACKET_SIZE];
+            while (true) {
+                int max = sizeof(buf);
+                if (to_cdc) {
+                    if (usb_cdc_write_available() < max) max = usb_cdc_write_available();
+                } else if (usb_stream_space() < max) {
+                    max = usb_stream_space();
+                }
+
+                int count = 0;
+                while (count < max && circular_buffer_pop(&tx_buffer, &buf[count])) {
+                    count++;
+                }
+                if (count == 0) break;
+                if (to_cdc) usb_cdc_write(buf, count);
+                if (to_stream) usb_stream_write_record(STREAM_REC_CONSOLE, buf, count);
+            }
 
-        // I2C TX buffer → USB CDC0
-        if (usb_cdc_connected()) {
-            uint8_t data;
+            if (to_cdc) {
+                if (i2c_slave_take_flush_request()) {
+                    // Master marked a message boundary: push everything now
+                    usb_cdc_flush();
+                }
+                usb_cdc_flush_task(circular_buffer_available(&tx_buffer));
+            }
+        }
+
+        // Telemetry channel → its own CDC, independent of the console
+        if (usb_cdc_n_connected(CDC_ITF_TELEMETRY)) {
+            // Only pop what the CDC can take; the rest stays in the ring
+            uint8_t buf[64];
+            int max = usb_cdc_n_write_available(CDC_ITF_TELEMETRY);
+            if (max > (int)sizeof(buf)) max = sizeof(buf);
             int count = 0;
-            while (circular_buffer_pop(&tx_buffer, &data) && count < 64) {
-                usb_cdc_write(&data, 1);
+            while (count < max && circular_buffer_pop(&telemetry_buffer, &buf[count])) {
                 count++;
             }
+            if (count > 0) {
+                usb_cdc_n_write(CDC_ITF_TELEMETRY, buf, count);
+            }
         }
 
-        // USB CDC0 → I2C RX buffer
+        // USB CDC0 → I2C RX buffer (urgent bytes jump the queue)
         uint8_t usb_buf[64];
-        int len = usb_cdc_read(usb_buf, sizeof(usb_buf));
+        int len = usb_bench_active() ? 0 : usb_cdc_read(usb_buf, sizeof(usb_buf));
         for (int i = 0; i < len; i++) {
-            circular_buffer_push(&rx_buffer, usb_buf[i]);
+            if (i2c_slave_is_urgent(usb_buf[i])) {
+                i2c_slave_push_urgent(usb_buf[i]);
+            } else {
+                circular_buffer_push(&rx_buffer, usb_buf[i]);
+            }
         }
+        i2c_slave_task();
 
         // Button handling
         button_event_t evt = button_task();
@@ -108,8 +224,10 @@ int main(void) {
                 total_errors
             );
 
-            uart_bridge_stats_t uart_stats = uart_bridge_get_stats();
-            lcd_ui_update_uart(&uart_stats);
+            for (uint8_t ch = 0; ch < UART_BRIDGE_CHANNELS; ch++) {
+                uart_bridge_stats_t uart_stats = uart_bridge_get_stats(ch);
+                lcd_ui_update_uart(ch, &uart_stats);
+            }
         }
 
         tight_loop_contents();
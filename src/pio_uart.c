@@ -0,0 +1,160 @@
+#include "pio_uart.h"
+#include "pio_uart.pio.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+
+// Programs are loaded once per PIO block and shared by all instances
+static int tx_offset[NUM_PIOS];
+static int rx_offset[NUM_PIOS];
+static bool loaded[NUM_PIOS];
+
+// Delay counts for the programs' bit loops (see pio_uart.pio):
+// TX bit = delay + 4 cycles, RX bit = 2 * delay + 6 cycles
+static inline uint32_t tx_delay(uint8_t oversample) { return oversample - 4; }
+static inline uint32_t rx_delay(uint8_t oversample) { return (oversample - 6) / 2; }
+
+// Restart both programs from the top and hand them the bit delay. The state
+// machines must be stopped.
+static void load_timing(pio_uart_t *u) {
+    pio_sm_clear_fifos(u->pio, u->sm_tx);
+    pio_sm_clear_fifos(u->pio, u->sm_rx);
+    pio_sm_restart(u->pio, u->sm_tx);
+    pio_sm_restart(u->pio, u->sm_rx);
+    pio_sm_exec(u->pio, u->sm_tx, pio_encode_jmp(u->tx_offset));
+    pio_sm_exec(u->pio, u->sm_rx, pio_encode_jmp(u->rx_offset));
+    pio_sm_put(u->pio, u->sm_tx, tx_delay(u->oversample));
+    pio_sm_put(u->pio, u->sm_rx, rx_delay(u->oversample));
+}
+
+bool pio_uart_init(pio_uart_t *u, PIO pio, uint tx_pin, uint rx_pin) {
+    uint idx = pio_get_index(pio);
+    if (!loaded[idx]) {
+        if (!pio_can_add_program(pio, &pio_uart_tx_program) ||
+            !pio_can_add_program(pio, &pio_uart_rx_program)) {
+            return false;
+        }
+        tx_offset[idx] = pio_add_program(pio, &pio_uart_tx_program);
+        rx_offset[idx] = pio_add_program(pio, &pio_uart_rx_program);
+        loaded[idx] = true;
+    }
+
+    int sm_tx = pio_claim_unused_sm(pio, false);
+    if (sm_tx < 0) return false;
+    int sm_rx = pio_claim_unused_sm(pio, false);
+    if (sm_rx < 0) {
+        pio_sm_unclaim(pio, sm_tx);
+        return false;
+    }
+
+    u->pio = pio;
+    u->sm_tx = sm_tx;
+    u->sm_rx = sm_rx;
+    u->tx_offset = tx_offset[idx];
+    u->rx_offset = rx_offset[idx];
+    u->tx_pin = tx_pin;
+    u->rx_pin = rx_pin;
+    u->enabled = false;
+
+    pio_sm_config c = pio_uart_tx_program_get_default_config(u->tx_offset);
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_out_pins(&c, tx_pin, 1);
+    sm_config_set_sideset_pins(&c, tx_pin);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    pio_sm_init(pio, sm_tx, u->tx_offset, &c);
+
+    // The RX program pulls its delay from the TX FIFO, so no FIFO join
+    c = pio_uart_rx_program_get_default_config(u->rx_offset);
+    sm_config_set_in_pins(&c, rx_pin);
+    sm_config_set_jmp_pin(&c, rx_pin);
+    sm_config_set_in_shift(&c, true, false, 32);
+    pio_sm_init(pio, sm_rx, u->rx_offset, &c);
+
+    pio_uart_configure(u, 115200, PIO_UART_DEFAULT_OVERSAMPLE);
+    return true;
+}
+
+void pio_uart_set_enabled(pio_uart_t *u, bool enable) {
+    if (enable == u->enabled) return;
+    u->enabled = enable;
+
+    if (!enable) {
+        pio_sm_set_enabled(u->pio, u->sm_tx, false);
+        pio_sm_set_enabled(u->pio, u->sm_rx, false);
+        return;
+    }
+
+    // TX idles high before the pin is handed over
+    pio_sm_set_pins_with_mask(u->pio, u->sm_tx, 1u << u->tx_pin, 1u << u->tx_pin);
+    pio_sm_set_pindirs_with_mask(u->pio, u->sm_tx, 1u << u->tx_pin, 1u << u->tx_pin);
+    pio_gpio_init(u->pio, u->tx_pin);
+    pio_sm_set_consecutive_pindirs(u->pio, u->sm_rx, u->rx_pin, 1, false);
+    pio_gpio_init(u->pio, u->rx_pin);
+    gpio_pull_up(u->rx_pin);
+
+    load_timing(u);
+    pio_sm_set_enabled(u->pio, u->sm_tx, true);
+    pio_sm_set_enabled(u->pio, u->sm_rx, true);
+}
+
+uint32_t pio_uart_configure(pio_uart_t *u, uint32_t baud, uint8_t oversample) {
+    if (baud == 0) return u->baud;
+
+    if (oversample < PIO_UART_MIN_OVERSAMPLE) oversample = PIO_UART_MIN_OVERSAMPLE;
+    if (oversample > PIO_UART_MAX_OVERSAMPLE) oversample = PIO_UART_MAX_OVERSAMPLE;
+    oversample &= ~1u;
+    u->oversample_cfg = oversample;
+
+    // Trade oversampling for speed at the top end; the divider can't go below 1
+    uint32_t clk = clock_get_hz(clk_sys);
+    while (oversample > PIO_UART_MIN_OVERSAMPLE && (uint64_t)oversample * baud > clk) {
+        oversample -= 2;
+    }
+
+    uint64_t cycles = (uint64_t)oversample * baud;
+    uint64_t div = ((uint64_t)clk * 256 + cycles / 2) / cycles;  // 16.8 fixed point
+    if (div < 0x100) div = 0x100;
+    if (div > 0xFFFFFF) div = 0xFFFFFF;
+
+    bool running = u->enabled;
+    if (running) {
+        pio_sm_set_enabled(u->pio, u->sm_tx, false);
+        pio_sm_set_enabled(u->pio, u->sm_rx, false);
+    }
+
+    u->oversample = oversample;
+    pio_sm_set_clkdiv_int_frac8(u->pio, u->sm_tx, div >> 8, div & 0xFF);
+    pio_sm_set_clkdiv_int_frac8(u->pio, u->sm_rx, div >> 8, div & 0xFF);
+    u->baud = (uint32_t)(((uint64_t)clk * 256) / (div * oversample));
+
+    if (running) {
+        load_timing(u);
+        pio_sm_set_enabled(u->pio, u->sm_tx, true);
+        pio_sm_set_enabled(u->pio, u->sm_rx, true);
+    }
+    return u->baud;
+}
+
+uint32_t pio_uart_set_baud(pio_uart_t *u, uint32_t baud) {
+    return pio_uart_configure(u, baud, u->oversample_cfg);
+}
+
+uint pio_uart_get_dreq(pio_uart_t *u, bool is_tx) {
+    return pio_get_dreq(u->pio, is_tx ? u->sm_tx : u->sm_rx, is_tx);
+}
+
+volatile void *pio_uart_tx_fifo(pio_uart_t *u) {
+    return &u->pio->txf[u->sm_tx];
+}
+
+const volatile void *pio_uart_rx_fifo(pio_uart_t *u) {
+    // The byte was shifted in from the left, so it sits in the top lane
+    return (const volatile uint8_t *)&u->pio->rxf[u->sm_rx] + 3;
+}
+
+bool pio_uart_take_framing_error(pio_uart_t *u) {
+    // "irq 4 rel" sets flag 4 + sm (mod 4)
+    uint flag = 4 + (u->sm_rx & 3);
+    if (!pio_interrupt_get(u->pio, flag)) return false;
+    pio_interrupt_clear(u->pio, flag);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef PIO_UART_H
+#define PIO_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/pio.h"
+
+// 8N1 UART built from two PIO state machines (TX and RX). The clock
+// divider is fractional (16.8), so arbitrary baud rates are hit to well
+// within UART tolerance.
+//
+// Oversampling is the number of state machine cycles per bit. It must be
+// even; it is lowered automatically when the baud rate is too high for the
+// requested value (max baud = clk_sys / PIO_UART_MIN_OVERSAMPLE).
+#define PIO_UART_MIN_OVERSAMPLE 6
+#define PIO_UART_MAX_OVERSAMPLE 32
+#ifndef PIO_UART_DEFAULT_OVERSAMPLE
+#define PIO_UART_DEFAULT_OVERSAMPLE 8
+#endif
+
+typedef struct {
+    PIO pio;
+    uint sm_tx;
+    uint sm_rx;
+    uint tx_offset;
+    uint rx_offset;
+    uint tx_pin;
+    uint rx_pin;
+    uint32_t baud;           // actual rate after divider rounding
+    uint8_t oversample_cfg;  // requested cycles per bit
+    uint8_t oversample;      // cycles per bit in use
+    bool enabled;
+} pio_uart_t;
+
+// Claims two state machines and loads the programs (once per PIO block).
+// The UART is left stopped; see pio_uart_set_enabled().
+bool pio_uart_init(pio_uart_t *u, PIO pio, uint tx_pin, uint rx_pin);
+// Takes over (or releases) the pins and starts (or stops) both state machines
+void pio_uart_set_enabled(pio_uart_t *u, bool enable);
+// Both return the baud rate actually set
+uint32_t pio_uart_configure(pio_uart_t *u, uint32_t baud, uint8_t oversample);
+uint32_t pio_uart_set_baud(pio_uart_t *u, uint32_t baud);
+uint pio_uart_get_dreq(pio_uart_t *u, bool is_tx);
+// DMA endpoints: 8-bit writes to the TX FIFO, 8-bit reads of the RX byte lane
+volatile void *pio_uart_tx_fifo(pio_uart_t *u);
+const volatile void *pio_uart_rx_fifo(pio_uart_t *u);
+bool pio_uart_take_framing_error(pio_uart_t *u);
+
+#endif
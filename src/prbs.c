@@ -0,0 +1,78 @@
+#include "prbs.h"
+#include "log.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+static uint32_t source_state = PRBS_SEED;
+static uint32_t sink_state = PRBS_SEED;
+static prbs_stats_t stats = {0};
+
+static prbs_stats_t last_report = {0};
+static uint32_t last_report_ms = 0;
+
+void prbs_init(void) {
+    prbs_reset();
+    last_report = stats;
+    last_report_ms = to_ms_since_boot(get_absolute_time());
+}
+
+void prbs_reset(void) {
+    source_state = PRBS_SEED;
+    sink_state = PRBS_SEED;
+    stats = (prbs_stats_t){0};
+    last_report = stats;
+}
+
+// Called from interrupt context
+uint8_t prbs_source_byte(void) {
+    stats.source_bytes++;
+    return prbs_next(&source_state);
+}
+
+void prbs_source_preview(uint8_t *buf, uint32_t len) {
+    uint32_t state = source_state;
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = prbs_next(&state);
+    }
+}
+
+// Called from interrupt context. A dropped or inserted byte desynchronizes
+// the checker; reset both ends to start over.
+void prbs_sink_byte(uint8_t data) {
+    uint8_t diff = data ^ prbs_next(&sink_state);
+    stats.sink_bytes++;
+    if (diff) {
+        stats.byte_errors++;
+        stats.bit_errors += __builtin_popcount(diff);
+    }
+}
+
+void prbs_task(void) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    uint32_t elapsed = now - last_report_ms;
+    if (elapsed < PRBS_REPORT_INTERVAL_MS) return;
+    last_report_ms = now;
+
+    uint32_t ints = save_and_disable_interrupts();
+    prbs_stats_t cur = stats;
+    restore_interrupts(ints);
+
+    uint32_t src = cur.source_bytes - last_report.source_bytes;
+    uint32_t sink = cur.sink_bytes - last_report.sink_bytes;
+    uint32_t bits = cur.bit_errors - last_report.bit_errors;
+    last_report = cur;
+
+    // Only report while a test is running
+    if (src == 0 && sink == 0) return;
+
+    LOG_INFO("PRBS: src %lu B/s, sink %lu B/s, %lu bit errors (total %lu/%lu bytes)",
+             (unsigned long)(src * 1000 / elapsed),
+             (unsigned long)(sink * 1000 / elapsed),
+             (unsigned long)bits,
+             (unsigned long)cur.bit_errors,
+             (unsigned long)cur.sink_bytes);
+}
+
+prbs_stats_t prbs_get_stats(void) {
+    return stats;
+}
@@ -0,0 +1,38 @@
+#ifndef PRBS_H
+#define PRBS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// PRBS31 (x^31 + x^28 + 1), generated MSB first, 8 bits per byte.
+// Source and sink both restart from this seed on prbs_reset().
+#define PRBS_SEED 0x7FFFFFFF
+#define PRBS_REPORT_INTERVAL_MS 1000
+
+// Taps at 31 and 28 are both more than 8 bits back, so a whole byte can be
+// computed from the current state in one step. The new state ends in the
+// byte just produced.
+static inline uint8_t prbs_next(uint32_t *state) {
+    uint32_t s = *state;
+    uint8_t byte = ((s >> 23) ^ (s >> 20)) & 0xFF;
+    *state = ((s << 8) | byte) & 0x7FFFFFFF;
+    return byte;
+}
+
+typedef struct {
+    uint32_t source_bytes;
+    uint32_t sink_bytes;
+    uint32_t bit_errors;
+    uint32_t byte_errors;
+} prbs_stats_t;
+
+void prbs_init(void);
+void prbs_reset(void);
+uint8_t prbs_source_byte(void);
+// The next len source bytes, without advancing the source
+void prbs_source_preview(uint8_t *buf, uint32_t len);
+void prbs_sink_byte(uint8_t data);
+void prbs_task(void);
+prbs_stats_t prbs_get_stats(void);
+
+#endif
@@ -0,0 +1,60 @@
+#include "ram_budget.h"
+#include "log.h"
+#include "tusb_config.h"
+#include "hardware/regs/addressmap.h"
+
+#ifndef I2CONSOLE_USB_PROFILE_NAME
+#define I2CONSOLE_USB_PROFILE_NAME "default"
+#endif
+
+// From the pico-sdk linker script
+extern char __bss_end__;
+extern char __end__;
+extern char __HeapLimit;
+extern char __StackLimit;
+extern char __StackTop;
+
+typedef struct {
+    const char *name;
+    size_t bytes;
+} ram_entry_t;
+
+static ram_entry_t entries[RAM_BUDGET_MAX_ENTRIES];
+static int entry_count = 0;
+
+void ram_budget_init(void) {
+    entry_count = 0;
+    ram_budget_add("TinyUSB CDC FIFOs",
+                   CFG_TUD_CDC * (CFG_TUD_CDC_RX_BUFSIZE + CFG_TUD_CDC_TX_BUFSIZE));
+#if CFG_TUD_VENDOR
+    ram_budget_add("TinyUSB vendor FIFOs",
+                   CFG_TUD_VENDOR * (CFG_TUD_VENDOR_RX_BUFSIZE + CFG_TUD_VENDOR_TX_BUFSIZE));
+#endif
+}
+
+void ram_budget_add(const char *name, size_t bytes) {
+    if (entry_count < RAM_BUDGET_MAX_ENTRIES) {
+        entries[entry_count].name = name;
+        entries[entry_count].bytes = bytes;
+        entry_count++;
+    }
+}
+
+void ram_budget_report(void) {
+    size_t total = SRAM_END - SRAM_BASE;
+    size_t statics = (size_t)(&__bss_end__ - (char *)SRAM_BASE);
+    size_t heap = (size_t)(&__HeapLimit - &__end__);
+    size_t stack = (size_t)(&__StackTop - &__StackLimit);
+    size_t listed = 0;
+
+    LOG_INFO("RAM budget (USB profile: %s), %u KB SRAM", I2CONSOLE_USB_PROFILE_NAME,
+             (unsigned)(total / 1024));
+    for (int i = 0; i < entry_count; i++) {
+        LOG_INFO("  %-24s %6u", entries[i].name, (unsigned)entries[i].bytes);
+        listed += entries[i].bytes;
+    }
+    LOG_INFO("  %-24s %6u", "other static data", (unsigned)(statics - listed));
+    LOG_INFO("  %-24s %6u", "static total", (unsigned)statics);
+    LOG_INFO("  %-24s %6u", "heap", (unsigned)heap);
+    LOG_INFO("  %-24s %6u", "main stack", (unsigned)stack);
+}
@@ -0,0 +1,14 @@
+#ifndef RAM_BUDGET_H
+#define RAM_BUDGET_H
+
+#include <stddef.h>
+
+#define RAM_BUDGET_MAX_ENTRIES 24
+
+// Modules register their large static buffers at init so the split of SRAM
+// between TinyUSB, rings and other buffers can be reported at runtime
+void ram_budget_init(void);
+void ram_budget_add(const char *name, size_t bytes);
+void ram_budget_report(void);
+
+#endif
@@ -0,0 +1,453 @@
+#include "shell.h"
+#include "usb_cdc.h"
+#include "i2c_slave.h"
+#include "uart_bridge.h"
+#include "usb_stream.h"
+#include "usb_bench.h"
+#include "usb_sof.h"
+#if I2CONSOLE_SNIFFER
+#include "i2c_sniffer.h"
+#endif
+#if I2CONSOLE_MSC
+#include "history.h"
+#include "usb_msc.h"
+#endif
+#include "prbs.h"
+#include "ram_budget.h"
+#include "log.h"
+#include "tusb.h"
+#include "pico/bootrom.h"
+#include "pico/time.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *name;
+    circular_buffer_t *cb;
+} shell_ring_t;
+
+static char line[SHELL_LINE_MAX];
+static int line_len = 0;
+static bool line_overflow = false;
+static bool last_dtr_state = false;
+
+static uint8_t output_data[SHELL_OUTPUT_SIZE];
+static circular_buffer_t output;
+
+#define DUMP_LINE_LEN 72
+_Static_assert((SHELL_DUMP_MAX / 16) * DUMP_LINE_LEN + SHELL_LINE_MAX <= SHELL_OUTPUT_SIZE,
+               "largest dump must fit in the shell output queue");
+
+// Longest txlog line, and room kept back for the closing line
+#define TXLOG_LINE_MAX 48
+
+static shell_ring_t rings[SHELL_MAX_RINGS];
+static int ring_count = 0;
+
+void shell_printf(const char *fmt, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len >= (int)sizeof(buf)) len = sizeof(buf) - 1;
+    circular_buffer_write(&output, (const uint8_t *)buf, len);
+}
+
+size_t shell_output_free(void) {
+    return circular_buffer_free(&output);
+}
+
+void shell_add_ring(const char *name, circular_buffer_t *cb) {
+    if (ring_count >= SHELL_MAX_RINGS) return;
+    rings[ring_count].name = name;
+    rings[ring_count].cb = cb;
+    ring_count++;
+}
+
+static shell_ring_t *find_ring(const char *name) {
+    for (int i = 0; i < ring_count; i++) {
+        if (strcasecmp(rings[i].name, name) == 0) return &rings[i];
+    }
+    shell_printf("unknown ring '%s' (", name);
+    for (int i = 0; i < ring_count; i++) {
+        shell_printf("%s%s", i ? ", " : "", rings[i].name);
+    }
+    shell_printf(")\n");
+    return NULL;
+}
+
+static bool parse_u32(const char *s, uint32_t *out) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+    if (*s == '\0' || *end != '\0') return false;
+    *out = v;
+    return true;
+}
+
+static void cmd_help(int argc, char **argv);
+
+static void cmd_stats(int argc, char **argv) {
+    i2c_stats_t i2c = i2c_slave_get_stats();
+    shell_printf("I2C: tx %lu rx %lu, overflow tx %lu rx %lu, errors %lu, recoveries %lu\n",
+                 (unsigned long)i2c.tx_bytes, (unsigned long)i2c.rx_bytes,
+                 (unsigned long)i2c.tx_overflow, (unsigned long)i2c.rx_overflow,
+                 (unsigned long)i2c.i2c_errors, (unsigned long)i2c.recoveries);
+
+    for (uint8_t ch = 0; ch < UART_BRIDGE_CHANNELS; ch++) {
+        uart_bridge_stats_t u = uart_bridge_get_stats(ch);
+        shell_printf("UART%u (%s%s): %lu baud, tx %lu rx %lu, dropped %lu, packets %lu\n",
+                     ch, uart_bridge_channel_name(ch), u.pio_backend ? ", PIO" : "",
+                     (unsigned long)u.baud_rate, (unsigned long)u.tx_bytes,
+                     (unsigned long)u.rx_bytes, (unsigned long)u.dropped,
+                     (unsigned long)u.packets);
+        shell_printf("  overrun %lu framing %lu parity %lu break %lu\n",
+                     (unsigned long)u.overruns, (unsigned long)u.framing_errors,
+                     (unsigned long)u.parity_errors, (unsigned long)u.breaks);
+    }
+
+    usb_stream_stats_t st = usb_stream_get_stats();
+    shell_printf("Stream: %s, %lu records, %lu bytes, %lu dropped\n",
+                 st.active ? "active" : "stopped", (unsigned long)st.records,
+                 (unsigned long)st.bytes, (unsigned long)st.dropped);
+
+#if I2CONSOLE_SNIFFER
+    sniffer_stats_t sn = sniffer_get_stats();
+    shell_printf("Sniffer: %s, %lu transactions, %lu filtered, %lu dropped, %lu FIFO overflows\n",
+                 sn.enabled ? "on" : "off", (unsigned long)sn.transactions,
+                 (unsigned long)sn.filtered, (unsigned long)sn.dropped,
+                 (unsigned long)sn.overflows);
+#endif
+
+    for (int i = 0; i < ring_count; i++) {
+        circular_buffer_t *cb = rings[i].cb;
+        shell_printf("Ring %s: %u/%u, drop %s\n", rings[i].name,
+                     (unsigned)circular_buffer_available(cb), (unsigned)cb->size,
+                     cb->policy == CB_DROP_NEWEST ? "newest" : "oldest");
+    }
+}
+
+static void cmd_reset(int argc, char **argv) {
+    i2c_slave_reset_stats();
+    uart_bridge_reset_stats();
+    usb_cdc_reset_flush_stats();
+    usb_stream_reset_stats();
+    usb_sof_reset_stats();
+    prbs_reset();
+    shell_printf("counters reset\n");
+}
+
+static void cmd_log(int argc, char **argv) {
+    static const char *const levels[] = {"debug", "info", "warn", "error"};
+    for (int i = 0; i < 4; i++) {
+        if (strcasecmp(argv[1], levels[i]) == 0) {
+            log_set_level((log_level_t)i);
+            shell_printf("log level %s\n", levels[i]);
+            return;
+        }
+    }
+    shell_printf("unknown level '%s'\n", argv[1]);
+}
+
+static void cmd_policy(int argc, char **argv) {
+    shell_ring_t *ring = find_ring(argv[1]);
+    if (!ring) return;
+    if (strcasecmp(argv[2], "oldest") == 0) {
+        circular_buffer_set_policy(ring->cb, CB_DROP_OLDEST);
+    } else if (strcasecmp(argv[2], "newest") == 0) {
+        circular_buffer_set_policy(ring->cb, CB_DROP_NEWEST);
+    } else {
+        shell_printf("policy must be oldest or newest\n");
+        return;
+    }
+    shell_printf("%s: drop %s when full\n", ring->name, argv[2]);
+}
+
+static void cmd_flush(int argc, char **argv) {
+    usb_cdc_flush_policy_t p = usb_cdc_get_flush_policy();
+    if (argc == 3) {
+        uint32_t v = 0;
+        bool on = strcasecmp(argv[2], "on") == 0;
+        if (strcasecmp(argv[1], "newline") == 0 && (on || strcasecmp(argv[2], "off") == 0)) {
+            p.flush_on_newline = on;
+        } else if (strcasecmp(argv[1], "idle") == 0 && parse_u32(argv[2], &v)) {
+            p.idle_flush_us = v;
+        } else if (strcasecmp(argv[1], "backlog") == 0 && parse_u32(argv[2], &v)) {
+            p.throughput_backlog = v;
+        } else {
+            shell_printf("usage: flush [newline on|off | idle <us> | backlog <bytes>]\n");
+            return;
+        }
+        usb_cdc_set_flush_policy(&p);
+    } else if (argc != 1) {
+        shell_printf("usage: flush [newline on|off | idle <us> | backlog <bytes>]\n");
+        return;
+    }
+    shell_printf("CDC0 flush: newline %s, idle %lu us, backlog %lu bytes\n",
+                 p.flush_on_newline ? "on" : "off", (unsigned long)p.idle_flush_us,
+                 (unsigned long)p.throughput_backlog);
+}
+
+static void cmd_usbstats(int argc, char **argv) {
+    usb_cdc_flush_stats_t st = usb_cdc_get_flush_stats();
+    uint32_t avg10 = st.packets ? (st.bytes * 10) / st.packets : 0;
+    shell_printf("CDC0: %lu bytes, %lu packets (%lu.%lu B/pkt), newline %lu, idle %lu, forced %lu, %s mode\n",
+                 (unsigned long)st.bytes, (unsigned long)st.packets,
+                 (unsigned long)(avg10 / 10), (unsigned long)(avg10 % 10),
+                 (unsigned long)st.newline_flushes,
+                 (unsigned long)st.idle_flushes, (unsigned long)st.forced_flushes,
+                 st.throughput_mode ? "throughput" : "latency");
+}
+
+static void cmd_packet(int argc, char **argv) {
+    uint32_t ch, gap;
+    if (!parse_u32(argv[1], &ch) || ch >= UART_BRIDGE_CHANNELS ||
+        !parse_u32(argv[2], &gap) || gap > 255) {
+        shell_printf("usage: packet <channel> <gap chars, 0 = off> [stream]\n");
+        return;
+    }
+    bool to_stream = argc > 3 && strcasecmp(argv[3], "stream") == 0;
+    uart_bridge_set_packet_mode(ch, gap, to_stream);
+    shell_printf("UART%lu: packet mode %s\n", (unsigned long)ch, gap ? "on" : "off");
+}
+
+static void cmd_dump(int argc, char **argv) {
+    shell_ring_t *ring = find_ring(argv[1]);
+    if (!ring) return;
+
+    uint32_t len = SHELL_DUMP_DEFAULT;
+    if (argc > 2 && !parse_u32(argv[2], &len)) {
+        shell_printf("bad length '%s'\n", argv[2]);
+        return;
+    }
+    if (len > SHELL_DUMP_MAX) len = SHELL_DUMP_MAX;
+
+    // Oldest bytes first; the ring itself is left untouched
+    uint8_t data[SHELL_DUMP_MAX];
+    size_t n = circular_buffer_peek(ring->cb, data, len);
+    shell_printf("%s: %u of %u bytes\n", ring->name, (unsigned)n,
+                 (unsigned)circular_buffer_available(ring->cb));
+    for (size_t off = 0; off < n; off += 16) {
+        char hex[16 * 3 + 1] = {0};
+        char ascii[17] = {0};
+        for (size_t i = 0; i < 16 && off + i < n; i++) {
+            uint8_t c = data[off + i];
+            snprintf(&hex[i * 3], 4, "%02X ", c);
+            ascii[i] = (c >= 0x20 && c < 0x7F) ? c : '.';
+        }
+        shell_printf("%04X  %-48s %s\n", (unsigned)off, hex, ascii);
+    }
+}
+
+static void cmd_bench(int argc, char **argv) {
+    if (argc == 1) {
+        usb_bench_stats_t st = usb_bench_get_stats();
+        shell_printf("bench %s: %lu ms, tx %lu rx %lu bytes, %lu stalls, %lu errors\n",
+                     usb_bench_mode_name(st.mode), (unsigned long)st.elapsed_ms,
+                     (unsigned long)st.tx_bytes, (unsigned long)st.rx_bytes,
+                     (unsigned long)st.stalls, (unsigned long)st.errors);
+        return;
+    }
+    if (strcasecmp(argv[1], "stop") == 0) {
+        usb_bench_stop();
+        return;
+    }
+
+    usb_bench_mode_t mode;
+    if (strcasecmp(argv[1], "source") == 0) mode = BENCH_SOURCE;
+    else if (strcasecmp(argv[1], "sink") == 0) mode = BENCH_SINK;
+    else if (strcasecmp(argv[1], "loop") == 0) mode = BENCH_LOOPBACK;
+    else {
+        shell_printf("usage: bench [source|sink|loop|stop] [counter|prbs] [seconds]\n");
+        return;
+    }
+
+    usb_bench_pattern_t pattern = BENCH_PATTERN_COUNTER;
+    uint32_t seconds = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcasecmp(argv[i], "prbs") == 0) pattern = BENCH_PATTERN_PRBS;
+        else if (strcasecmp(argv[i], "counter") == 0) pattern = BENCH_PATTERN_COUNTER;
+        else if (!parse_u32(argv[i], &seconds)) {
+            shell_printf("bad argument '%s'\n", argv[i]);
+            return;
+        }
+    }
+    usb_bench_start(mode, pattern, seconds);
+}
+
+#if I2CONSOLE_MSC
+static void cmd_msc(int argc, char **argv) {
+    if (argc > 1) {
+        if (strcasecmp(argv[1], "refresh") != 0) {
+            shell_printf("usage: msc [refresh]\n");
+            return;
+        }
+        usb_msc_refresh();
+    }
+    usb_msc_stats_t st = usb_msc_get_stats();
+    shell_printf("msc: snapshot %lu, console %u B, log %u B, %lu sectors read%s\n",
+                 (unsigned long)history_snapshot_count(),
+                 (unsigned)history_file_size(HISTORY_FILE_CONSOLE),
+                 (unsigned)history_file_size(HISTORY_FILE_LOG),
+                 (unsigned long)st.sectors_read, st.ejected ? ", ejected" : "");
+}
+#endif
+
+static void cmd_sof(int argc, char **argv) {
+    usb_sof_stats_t st = usb_sof_get_stats();
+    if (st.valid) {
+        shell_printf("sof: frame %u at %llu us\n", st.frame, (unsigned long long)st.sof_us);
+    } else {
+        shell_printf("sof: no sample (bus idle or not mounted)\n");
+    }
+    shell_printf("%lu frames, %lu samples, %lu late, %lu mismatched\n",
+                 (unsigned long)st.frames, (unsigned long)st.samples,
+                 (unsigned long)st.late, (unsigned long)st.mismatch);
+}
+
+static void cmd_txlog(int argc, char **argv) {
+    shell_printf("start_us dur_us reg wr rd flags\n");
+
+    // Only pop what the output queue can hold; the rest stays in the
+    // ring for the next txlog
+    i2c_txn_t txn;
+    bool more = false;
+    while (true) {
+        if (shell_output_free() < 2 * TXLOG_LINE_MAX) {
+            more = true;
+            break;
+        }
+        if (!i2c_slave_txn_pop(&txn)) break;
+        shell_printf("%lu %lu 0x%02X %u %u %c%c%c%c\n",
+                     (unsigned long)txn.start_us,
+                     (unsigned long)(txn.stop_us - txn.start_us),
+                     txn.reg, txn.write_len, txn.read_len,
+                     (txn.flags & I2C_TXN_WRITE) ? 'W' : '-',
+                     (txn.flags & I2C_TXN_READ) ? 'R' : '-',
+                     (txn.flags & I2C_TXN_ABORT) ? 'A' : '-',
+                     (txn.flags & I2C_TXN_NACK) ? 'N' : '-');
+    }
+
+    if (more) {
+        shell_printf("more pending, run txlog again\n");
+    } else {
+        shell_printf("dropped %lu\n", (unsigned long)i2c_slave_get_stats().txn_dropped);
+    }
+}
+
+static void cmd_ram(int argc, char **argv) {
+    ram_budget_report();
+}
+
+static void cmd_bootloader(int argc, char **argv) {
+    tud_cdc_n_write_str(CDC_ITF_DEBUG, "Entering bootloader mode...\n");
+    tud_cdc_n_write_flush(CDC_ITF_DEBUG);
+    sleep_ms(100);
+    reset_usb_boot(0, 0);
+}
+
+static const shell_cmd_t commands[] = {
+    {"help", "", "List commands", 1, cmd_help},
+    {"stats", "", "Show I2C, UART, stream and ring counters", 1, cmd_stats},
+    {"reset", "", "Reset all counters", 1, cmd_reset},
+    {"log", "<debug|info|warn|error>", "Set the log level", 2, cmd_log},
+    {"policy", "<ring> <oldest|newest>", "What a full ring drops", 3, cmd_policy},
+    {"flush", "[newline on|off | idle <us> | backlog <bytes>]", "Show or set the CDC0 flush policy", 1, cmd_flush},
+    {"usbstats", "", "CDC0 flush statistics", 1, cmd_usbstats},
+    {"packet", "<ch> <gap chars> [stream]", "UART packet mode", 3, cmd_packet},
+    {"dump", "<ring> [bytes]", "Hex dump of a ring without consuming it", 2, cmd_dump},
+    {"bench", "[source|sink|loop|stop] [counter|prbs] [s]", "USB benchmark on CDC0", 1, cmd_bench},
+    {"sof", "", "Last USB frame number / device time pair", 1, cmd_sof},
+#if I2CONSOLE_MSC
+    {"msc", "[refresh]", "History drive status; refresh its snapshot", 1, cmd_msc},
+#endif
+    {"txlog", "", "Dump the I2C transaction log", 1, cmd_txlog},
+    {"ram", "", "RAM budget report", 1, cmd_ram},
+    {"bootloader", "", "Reboot into the USB bootloader", 1, cmd_bootloader},
+    {"reboot", "", "Same as bootloader", 1, cmd_bootloader},
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+static void cmd_help(int argc, char **argv) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        const shell_cmd_t *c = &commands[i];
+        shell_printf("%-10s %-26s %s\n", c->name, c->usage, c->help);
+    }
+}
+
+static void execute(char *text) {
+    char *argv[SHELL_MAX_ARGS];
+    int argc = 0;
+    char *save;
+    for (char *tok = strtok_r(text, " \t", &save); tok && argc < SHELL_MAX_ARGS;
+         tok = strtok_r(NULL, " \t", &save)) {
+        argv[argc++] = tok;
+    }
+    if (argc == 0) return;
+
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        const shell_cmd_t *c = &commands[i];
+        if (strcasecmp(argv[0], c->name) != 0) continue;
+        if (argc < c->min_args) {
+            shell_printf("usage: %s %s\n", c->name, c->usage);
+        } else {
+            c->handler(argc, argv);
+        }
+        return;
+    }
+    shell_printf("unknown command '%s', try help\n", argv[0]);
+}
+
+void shell_init(void) {
+    circular_buffer_init(&output, output_data, SHELL_OUTPUT_SIZE);
+    circular_buffer_set_policy(&output, CB_DROP_NEWEST);
+    ram_budget_add("Shell output", SHELL_OUTPUT_SIZE);
+}
+
+void shell_task(void) {
+    if (tud_cdc_n_connected(CDC_ITF_DEBUG)) {
+        bool dtr = tud_cdc_n_get_line_state(CDC_ITF_DEBUG) & 0x01;
+        if (last_dtr_state && !dtr) {
+            reset_usb_boot(0, 0);
+        }
+        last_dtr_state = dtr;
+    } else {
+        circular_buffer_clear(&output);
+        return;
+    }
+
+    for (int n = 0; n < SHELL_INPUT_PER_TASK && tud_cdc_n_available(CDC_ITF_DEBUG); n++) {
+        uint8_t c;
+        tud_cdc_n_read(CDC_ITF_DEBUG, &c, 1);
+
+        if (c == '\n' || c == '\r') {
+            if (line_overflow) {
+                shell_printf("line too long\n");
+            } else if (line_len > 0) {
+                line[line_len] = '\0';
+                execute(line);
+            }
+            line_len = 0;
+            line_overflow = false;
+        } else if (c == '\b' || c == 0x7F) {
+            if (line_len > 0) line_len--;
+        } else if (line_len < SHELL_LINE_MAX - 1) {
+            line[line_len++] = c;
+        } else {
+            line_overflow = true;
+        }
+    }
+
+    uint32_t space = tud_cdc_n_write_available(CDC_ITF_DEBUG);
+    if (space > 0 && circular_buffer_available(&output) > 0) {
+        uint8_t buf[64];
+        if (space > sizeof(buf)) space = sizeof(buf);
+        size_t n = circular_buffer_read(&output, buf, space);
+        tud_cdc_n_write(CDC_ITF_DEBUG, buf, n);
+        tud_cdc_n_write_flush(CDC_ITF_DEBUG);
+    }
+}
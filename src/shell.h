@@ -0,0 +1,38 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "circular_buffer.h"
+
+// Line-based command shell on the debug CDC. Input is consumed a bounded
+// amount per call and output is queued and drained as USB space allows, so
+// the shell never holds up the data path.
+#define SHELL_LINE_MAX 80
+#define SHELL_MAX_ARGS 6
+#define SHELL_INPUT_PER_TASK 64
+#define SHELL_OUTPUT_SIZE 2048
+#define SHELL_MAX_RINGS 4
+#define SHELL_DUMP_DEFAULT 64
+// A dump line is 72 characters per 16 bytes; the largest dump has to fit
+// in the output queue
+#define SHELL_DUMP_MAX 256
+
+typedef struct {
+    const char *name;
+    const char *usage;
+    const char *help;
+    uint8_t min_args;  // including the command name
+    void (*handler)(int argc, char **argv);
+} shell_cmd_t;
+
+void shell_init(void);
+void shell_task(void);
+// Rings the "policy" and "dump" commands can act on
+void shell_add_ring(const char *name, circular_buffer_t *cb);
+// Queues output; whatever doesn't fit in the output buffer is dropped
+void shell_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+// Room left in the output queue, for commands that drain a source
+size_t shell_output_free(void);
+
+#endif
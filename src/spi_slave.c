@@ -0,0 +1,219 @@
+#include "spi_slave.h"
+#include "i2c_slave.h"
+#include "ram_budget.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+// Frame protocol (one frame per CS assertion):
+//   [reg][data...]   write data to reg, same semantics as an I2C write
+//   [reg]            select reg for subsequent read frames
+//   [SPI_CMD_READ]   MISO carries [len][payload...] staged from the
+//                    selected register after the previous frame
+// A response is staged before the master clocks it. Registers whose reads
+// have side effects (data, loopback, urgent, PRBS source) are only
+// previewed; the real reads happen once the frame shows how many bytes
+// were clocked out, so unread data stays where it was.
+//
+// The CS IRQ only resets the block and re-arms DMA into the other frame
+// buffer; spi_slave_task() parses the frame and loads the response. Until
+// it has, MISO answers a read with a zero length byte.
+
+#define SPI_SLAVE_INST spi0
+#define SPI_SLAVE_PAYLOAD_MAX (SPI_SLAVE_STAGE_SIZE - 1)
+
+static spi_slave_stats_t stats = {0};
+
+static int dma_rx;
+static int dma_tx;
+static uint8_t rx_frames[2][SPI_SLAVE_FRAME_SIZE];
+static uint8_t tx_stage[SPI_SLAVE_STAGE_SIZE];
+static uint32_t staged_len = 0;
+static const uint8_t tx_empty = 0;
+
+static uint8_t rx_fill = 0;             // buffer the RX DMA writes into
+static volatile bool frame_ready = false;
+static volatile uint8_t ready_buf;
+static volatile uint32_t ready_len;
+static volatile uint32_t ready_staged;  // payload bytes MISO offered during it
+static volatile uint32_t armed_len = 0;
+static volatile bool restage = true;
+
+static uint8_t read_register = REG_DATA_START;
+
+// Register access runs from the main loop, so it is serialized with the
+// I2C IRQ by masking interrupts around each call
+static void stage_response(void) {
+    size_t max = i2c_slave_reg_read_consumes(read_register) ? SPI_SLAVE_PAYLOAD_MAX
+                                                            : SPI_SLAVE_REG_READ_LEN;
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t len = i2c_slave_reg_preview(read_register, &tx_stage[1], max);
+    restore_interrupts(ints);
+
+    tx_stage[0] = (uint8_t)len;
+    memset(&tx_stage[1 + len], 0, SPI_SLAVE_PAYLOAD_MAX - len);
+    staged_len = len;
+}
+
+static void consume_response(uint32_t clocked, uint32_t offered) {
+    uint32_t consumed = clocked < offered ? clocked : offered;
+
+    if (i2c_slave_reg_read_consumes(read_register)) {
+        uint32_t ints = save_and_disable_interrupts();
+        i2c_slave_reg_commit(read_register, consumed);
+        restore_interrupts(ints);
+    }
+    if (i2c_slave_is_data_register(read_register)) {
+        stats.tx_bytes += consumed;
+    }
+}
+
+static void process_frame(const uint8_t *frame, uint32_t len, uint32_t offered) {
+    uint8_t cmd = frame[0];
+    stats.frames++;
+
+    if (cmd == SPI_CMD_READ) {
+        // The length byte went out together with the command byte
+        consume_response(len - 1, offered);
+    } else if (len == 1) {
+        read_register = cmd;
+    } else {
+        for (uint32_t i = 1; i < len; i++) {
+            uint32_t ints = save_and_disable_interrupts();
+            i2c_slave_reg_write(cmd, (i - 1) > 0xFF ? 0xFF : (uint8_t)(i - 1), frame[i]);
+            restore_interrupts(ints);
+        }
+        stats.rx_bytes += len - 1;
+    }
+}
+
+static void spi_slave_configure(void) {
+    // Resetting the block is the only way to discard TX FIFO entries that
+    // were preloaded for a response the master did not clock out
+    spi_init(SPI_SLAVE_INST, 1000000);
+    spi_set_format(SPI_SLAVE_INST, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    spi_set_slave(SPI_SLAVE_INST, true);
+}
+
+// Arms both channels for the next frame. Without a staged response MISO
+// sends a single zero length byte.
+static void spi_slave_arm(bool staged) {
+    dma_channel_transfer_to_buffer_now(dma_rx, rx_frames[rx_fill], SPI_SLAVE_FRAME_SIZE);
+    if (staged) {
+        dma_channel_transfer_from_buffer_now(dma_tx, tx_stage, SPI_SLAVE_STAGE_SIZE);
+        armed_len = staged_len;
+    } else {
+        dma_channel_transfer_from_buffer_now(dma_tx, &tx_empty, 1);
+        armed_len = 0;
+    }
+}
+
+// CS deasserted: the frame is complete
+static void spi_slave_cs_irq_handler(void) {
+    if (!(gpio_get_irq_event_mask(SPI_SLAVE_CS_PIN) & GPIO_IRQ_EDGE_RISE)) return;
+    gpio_acknowledge_irq(SPI_SLAVE_CS_PIN, GPIO_IRQ_EDGE_RISE);
+
+    spi_hw_t *hw = spi_get_hw(SPI_SLAVE_INST);
+
+    // Let DMA drain the last bytes from the RX FIFO
+    for (int i = 0; i < 100 && (hw->sr & SPI_SSPSR_RNE_BITS); i++) {
+        if (!dma_channel_is_busy(dma_rx)) break;
+    }
+
+    if (hw->ris & SPI_SSPRIS_RORRIS_BITS) {
+        stats.overruns++;
+    }
+
+    uint32_t len = SPI_SLAVE_FRAME_SIZE - dma_channel_hw_addr(dma_rx)->transfer_count;
+
+    dma_channel_abort(dma_rx);
+    dma_channel_abort(dma_tx);
+    spi_slave_configure();
+
+    if (len > 0) {
+        if (frame_ready) {
+            // The previous frame is still unparsed; reuse this buffer
+            stats.dropped++;
+        } else {
+            ready_buf = rx_fill;
+            ready_len = len;
+            ready_staged = armed_len;
+            frame_ready = true;
+            rx_fill ^= 1;
+        }
+    }
+
+    spi_slave_arm(false);
+    restage = true;
+}
+
+void spi_slave_task(void) {
+    if (frame_ready) {
+        process_frame(rx_frames[ready_buf], ready_len, ready_staged);
+        frame_ready = false;
+        restage = true;
+    }
+    if (!restage) return;
+
+    stage_response();
+
+    // Swapping the response needs a block reset, which is only safe while
+    // no frame is in progress and none is waiting to be parsed
+    uint32_t ints = save_and_disable_interrupts();
+    if (!frame_ready && gpio_get(SPI_SLAVE_CS_PIN) &&
+        dma_channel_hw_addr(dma_rx)->transfer_count == SPI_SLAVE_FRAME_SIZE) {
+        dma_channel_abort(dma_rx);
+        dma_channel_abort(dma_tx);
+        spi_slave_configure();
+        spi_slave_arm(true);
+        restage = false;
+    }
+    restore_interrupts(ints);
+}
+
+void spi_slave_init(void) {
+    ram_budget_add("SPI frames", sizeof(rx_frames) + sizeof(tx_stage));
+
+    spi_slave_configure();
+    gpio_set_function(SPI_SLAVE_RX_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SPI_SLAVE_CS_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SPI_SLAVE_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(SPI_SLAVE_TX_PIN, GPIO_FUNC_SPI);
+    // Keep CS idle when no master is connected
+    gpio_pull_up(SPI_SLAVE_CS_PIN);
+
+    spi_hw_t *hw = spi_get_hw(SPI_SLAVE_INST);
+
+    dma_rx = dma_claim_unused_channel(true);
+    dma_channel_config rx_cfg = dma_channel_get_default_config(dma_rx);
+    channel_config_set_transfer_data_size(&rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_cfg, false);
+    channel_config_set_write_increment(&rx_cfg, true);
+    channel_config_set_dreq(&rx_cfg, spi_get_dreq(SPI_SLAVE_INST, false));
+    dma_channel_configure(dma_rx, &rx_cfg, rx_frames[0], &hw->dr, SPI_SLAVE_FRAME_SIZE, false);
+
+    dma_tx = dma_claim_unused_channel(true);
+    dma_channel_config tx_cfg = dma_channel_get_default_config(dma_tx);
+    channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_cfg, true);
+    channel_config_set_write_increment(&tx_cfg, false);
+    channel_config_set_dreq(&tx_cfg, spi_get_dreq(SPI_SLAVE_INST, true));
+    dma_channel_configure(dma_tx, &tx_cfg, &hw->dr, tx_stage, SPI_SLAVE_STAGE_SIZE, false);
+
+    stage_response();
+    spi_slave_arm(true);
+    restage = false;
+
+    // Same priority as the I2C IRQ, so neither delays the other
+    gpio_add_raw_irq_handler(SPI_SLAVE_CS_PIN, spi_slave_cs_irq_handler);
+    gpio_set_irq_enabled(SPI_SLAVE_CS_PIN, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_priority(IO_IRQ_BANK0, I2C_SLAVE_IRQ_PRIORITY);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+spi_slave_stats_t spi_slave_get_stats(void) {
+    return stats;
+}
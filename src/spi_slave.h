@@ -0,0 +1,34 @@
+#ifndef SPI_SLAVE_H
+#define SPI_SLAVE_H
+
+#include <stdint.h>
+
+// SPI0 in slave mode, SPI mode 3 (CPOL=1, CPHA=1), MSB first
+#define SPI_SLAVE_RX_PIN  16  // MOSI
+#define SPI_SLAVE_CS_PIN  17
+#define SPI_SLAVE_SCK_PIN 18
+#define SPI_SLAVE_TX_PIN  19  // MISO
+
+// Largest frame (command byte + data) accepted per CS assertion
+#define SPI_SLAVE_FRAME_SIZE 1024
+// Staged read response: 1 length byte + up to 255 payload bytes
+#define SPI_SLAVE_STAGE_SIZE 256
+// Bytes staged for a read of a non-data register
+#define SPI_SLAVE_REG_READ_LEN 16
+
+// Command byte of a read frame; any other value is a register number
+#define SPI_CMD_READ 0xFE
+
+typedef struct {
+    uint32_t frames;
+    uint32_t rx_bytes;    // payload bytes written by the master
+    uint32_t tx_bytes;    // payload bytes clocked out in read frames
+    uint32_t overruns;    // RX FIFO overruns (RORRIS), e.g. frames longer than SPI_SLAVE_FRAME_SIZE
+    uint32_t dropped;     // frames that ended before the previous one was parsed
+} spi_slave_stats_t;
+
+void spi_slave_init(void);
+void spi_slave_task(void);
+spi_slave_stats_t spi_slave_get_stats(void);
+
+#endif
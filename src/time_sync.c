@@ -0,0 +1,87 @@
+#include "time_sync.h"
+#include "log.h"
+#include "hardware/sync.h"
+
+static time_sync_status_t status = {0};
+
+// Latest sample from the I2C ISR, consumed by time_sync_task()
+static volatile bool sample_pending = false;
+static uint64_t pending_master_us;
+static uint64_t pending_device_us;
+
+void time_sync_init(void) {
+    status = (time_sync_status_t){0};
+    sample_pending = false;
+}
+
+// Called from interrupt context; only stores the sample
+void time_sync_submit(uint64_t master_us, uint64_t device_us) {
+    pending_master_us = master_us;
+    pending_device_us = device_us;
+    sample_pending = true;
+}
+
+void time_sync_task(void) {
+    if (!sample_pending) return;
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint64_t master_us = pending_master_us;
+    uint64_t device_us = pending_device_us;
+    sample_pending = false;
+    restore_interrupts(ints);
+
+    int64_t offset = (int64_t)(master_us - device_us);
+
+    if (status.synced) {
+        int64_t interval = (int64_t)(device_us - status.last_sample_us);
+        if (interval < TIME_SYNC_MIN_DRIFT_INTERVAL_US) {
+            // Too close to the previous sample for a useful drift estimate
+            status.offset_us = offset;
+            status.last_sample_us = device_us;
+            status.samples++;
+            return;
+        }
+
+        int64_t delta = offset - status.offset_us;
+        if (delta > interval || delta < -interval) {
+            // Master clock stepped (reset or adjusted); start over
+            LOG_WARN("Time sync: master clock step of %lld us, resyncing", (long long)delta);
+            status.drift_ppb = 0;
+            status.samples = 0;
+        } else {
+            // In double: delta * 1e9 overflows int64 once samples are more
+            // than ~2.5 h apart. Runs once per sample, so soft-float is fine.
+            int64_t drift = (int64_t)((double)delta * 1e9 / (double)interval);
+            if (drift > -TIME_SYNC_MAX_DRIFT_PPB && drift < TIME_SYNC_MAX_DRIFT_PPB) {
+                if (status.samples < 2) {
+                    status.drift_ppb = (int32_t)drift;
+                } else {
+                    // Exponential moving average, alpha = 1/4
+                    status.drift_ppb += (int32_t)((drift - status.drift_ppb) / 4);
+                }
+            } else {
+                LOG_WARN("Time sync: drift sample %lld ppb rejected", (long long)drift);
+            }
+        }
+    } else {
+        LOG_INFO("Time sync acquired: offset %lld us", (long long)offset);
+    }
+
+    status.offset_us = offset;
+    status.last_sample_us = device_us;
+    status.samples++;
+    status.synced = true;
+}
+
+bool time_sync_to_master(uint64_t device_us, uint64_t *master_us) {
+    if (!status.synced) return false;
+
+    int64_t elapsed = (int64_t)(device_us - status.last_sample_us);
+    int64_t correction = (elapsed * status.drift_ppb) / 1000000000LL;
+    *master_us = device_us + status.offset_us + correction;
+    return true;
+}
+
+time_sync_status_t time_sync_get_status(void) {
+    return status;
+}
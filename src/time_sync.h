@@ -0,0 +1,26 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Minimum spacing between samples used for the drift estimate
+#define TIME_SYNC_MIN_DRIFT_INTERVAL_US 100000
+// Drift samples beyond this are treated as bogus and ignored
+#define TIME_SYNC_MAX_DRIFT_PPB 1000000
+
+typedef struct {
+    bool synced;
+    int64_t offset_us;      // master - device at the last sample
+    int32_t drift_ppb;      // master clock rate relative to device clock
+    uint32_t samples;
+    uint64_t last_sample_us; // device time of the last sample
+} time_sync_status_t;
+
+void time_sync_init(void);
+void time_sync_submit(uint64_t master_us, uint64_t device_us);
+void time_sync_task(void);
+bool time_sync_to_master(uint64_t device_us, uint64_t *master_us);
+time_sync_status_t time_sync_get_status(void);
+
+#endif
@@ -4,13 +4,32 @@
 #define CFG_TUSB_RHPORT0_MODE (OPT_MODE_DEVICE)
 #define CFG_TUD_ENDPOINT0_SIZE 64
 
-#define CFG_TUD_CDC 3
+#include "usb_cdc.h"
+
+// Interface layout (and so the count) depends on the UART channel and
+// sniffer build options
+#define CFG_TUD_CDC CDC_ITF_COUNT
+
+// TinyUSB sizes every CDC FIFO the same; the USB build profile in
+// CMakeLists.txt may override these
+#ifndef CFG_TUD_CDC_RX_BUFSIZE
 #define CFG_TUD_CDC_RX_BUFSIZE 256
+#endif
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
 #define CFG_TUD_CDC_TX_BUFSIZE 256
+#endif
 
-#define CFG_TUD_MSC 0
+#define CFG_TUD_MSC I2CONSOLE_MSC
+#define CFG_TUD_MSC_EP_BUFSIZE 512
 #define CFG_TUD_HID 0
 #define CFG_TUD_MIDI 0
-#define CFG_TUD_VENDOR 0
+#define CFG_TUD_VENDOR 2  // I2C adapter, record stream
+#define CFG_TUD_VENDOR_EPSIZE 64
+#ifndef CFG_TUD_VENDOR_RX_BUFSIZE
+#define CFG_TUD_VENDOR_RX_BUFSIZE 256
+#endif
+#ifndef CFG_TUD_VENDOR_TX_BUFSIZE
+#define CFG_TUD_VENDOR_TX_BUFSIZE 256
+#endif
 
 #endif
@@ -0,0 +1,591 @@
+#include "uart_bridge.h"
+#include "pio_uart.h"
+#include "log.h"
+#include "ram_budget.h"
+#include "usb_stream.h"
+#include "tusb.h"
+#include "hardware/uart.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include <string.h>
+
+// The RX channel is re-armed every half ring from the DMA IRQ, which also
+// gives an exact count of bytes written for overwrite detection
+#define RX_HALF (UART_BRIDGE_RX_RING_SIZE / 2)
+// Unread bytes this close to the DMA write position may be overwritten
+// while they are copied out, so they count as dropped
+#define RX_MARGIN 256
+
+// Packet mode: a packet has to fit in the sink's FIFO to go out as one write
+#define UART_PACKET_HEADER 5  // [channel][first byte time µs LE32]
+#define MIN_U32(a, b) ((a) < (b) ? (a) : (b))
+#define CDC_PACKET_LIMIT MIN_U32(UART_BRIDGE_PACKET_MAX, CFG_TUD_CDC_TX_BUFSIZE)
+#define STREAM_PACKET_LIMIT MIN_U32(UART_BRIDGE_PACKET_MAX, \
+    CFG_TUD_VENDOR_TX_BUFSIZE - USB_STREAM_HEADER_SIZE - UART_PACKET_HEADER)
+
+// pio1 runs the dedicated PIO channel; the hardware channels' fallback
+// engines live on pio2 (both programs fit twice in one block)
+#define UART_BRIDGE_PIO pio1
+#define UART_BRIDGE_FALLBACK_PIO pio2
+
+typedef enum {
+    BACKEND_HW = 0,
+    BACKEND_PIO
+} backend_t;
+
+typedef struct {
+    const char *name;
+    uint8_t cdc_itf;
+    backend_t backend;
+    uart_inst_t *uart;       // BACKEND_HW
+    pio_uart_t pio;          // BACKEND_PIO, or the fallback engine
+    uint tx_pin;
+    uint rx_pin;
+    bool flow_control;
+    bool pio_fallback;       // HW channel may switch to PIO for odd rates
+
+    backend_t active;
+    uint8_t *ring;
+    uint8_t *tx_buf;
+    int dma_rx;
+    int dma_tx;
+    volatile uint32_t rx_halves;  // completed half-ring transfers
+    uint32_t rx_read;             // total bytes consumed
+    uint32_t rx_last_written;
+    uint32_t rx_last_change_us;
+    uint32_t idle_us;
+    bool rx_unflushed;
+    uint8_t packet_gap_chars;     // 0 = stream bytes as they arrive
+    bool packet_to_stream;
+    uint32_t packet_gap_us;
+    uint32_t packet_start_us;
+    bool rts_asserted;
+    uart_bridge_stats_t stats;
+} bridge_channel_t;
+
+static uint8_t rx_rings[UART_BRIDGE_CHANNELS][UART_BRIDGE_RX_RING_SIZE]
+    __attribute__((aligned(UART_BRIDGE_RX_RING_SIZE)));
+static uint8_t tx_bufs[UART_BRIDGE_CHANNELS][UART_BRIDGE_TX_BUFFER_SIZE];
+static uint8_t packet_buf[UART_PACKET_HEADER + UART_BRIDGE_PACKET_MAX];
+
+static bridge_channel_t channels[UART_BRIDGE_CHANNELS] = {
+    {
+        .name = "uart1 GP4/5",
+        .cdc_itf = CDC_ITF_UART,
+        .backend = BACKEND_HW,
+        .uart = uart1,
+        .tx_pin = UART_BRIDGE_TX_PIN,
+        .rx_pin = UART_BRIDGE_RX_PIN,
+        .flow_control = UART_BRIDGE_FLOW_CONTROL,
+        .pio_fallback = UART_BRIDGE_PIO_FALLBACK,
+    },
+#if UART_BRIDGE_CHANNELS > 1
+    {
+        .name = "uart0 GP0/1",
+        .cdc_itf = CDC_ITF_UART_EXTRA,
+        .backend = BACKEND_HW,
+        .uart = uart0,
+        .tx_pin = UART_BRIDGE1_TX_PIN,
+        .rx_pin = UART_BRIDGE1_RX_PIN,
+        .pio_fallback = UART_BRIDGE_PIO_FALLBACK,
+    },
+#endif
+#if UART_BRIDGE_CHANNELS > 2
+    {
+        .name = "PIO GP20/21",
+        .cdc_itf = CDC_ITF_UART_EXTRA + 1,
+        .backend = BACKEND_PIO,
+        .tx_pin = UART_BRIDGE2_TX_PIN,
+        .rx_pin = UART_BRIDGE2_RX_PIN,
+    },
+#endif
+};
+
+// Hardware UART error interrupts, indexed by uart_get_index()
+static bridge_channel_t *uart_irq_channel[2];
+
+static void uart_error_irq(bridge_channel_t *ch) {
+    uart_hw_t *hw = uart_get_hw(ch->uart);
+    uint32_t mis = hw->mis;
+
+    if (mis & UART_UARTMIS_OEMIS_BITS) ch->stats.overruns++;
+    if (mis & UART_UARTMIS_FEMIS_BITS) ch->stats.framing_errors++;
+    if (mis & UART_UARTMIS_PEMIS_BITS) ch->stats.parity_errors++;
+    if (mis & UART_UARTMIS_BEMIS_BITS) ch->stats.breaks++;
+    hw->icr = mis;
+}
+
+static void uart0_error_irq_handler(void) {
+    if (uart_irq_channel[0]) uart_error_irq(uart_irq_channel[0]);
+}
+
+static void uart1_error_irq_handler(void) {
+    if (uart_irq_channel[1]) uart_error_irq(uart_irq_channel[1]);
+}
+
+static void dma_rx_irq_handler(void) {
+    for (int i = 0; i < UART_BRIDGE_CHANNELS; i++) {
+        bridge_channel_t *ch = &channels[i];
+        if (ch->dma_rx < 0) continue;
+        if (!dma_channel_get_irq1_status(ch->dma_rx)) continue;
+        dma_channel_acknowledge_irq1(ch->dma_rx);
+        ch->rx_halves++;
+        // Write address keeps wrapping through the ring; only the count reloads
+        dma_channel_set_trans_count(ch->dma_rx, RX_HALF, true);
+    }
+}
+
+static void update_idle_time(bridge_channel_t *ch) {
+    // Two characters of 10-12 bits each
+    uint32_t baud = ch->stats.baud_rate ? ch->stats.baud_rate : UART_BRIDGE_DEFAULT_BAUD;
+    uint32_t t = 24u * 1000000u / baud;
+    ch->idle_us = t < UART_BRIDGE_IDLE_MIN_US ? UART_BRIDGE_IDLE_MIN_US : t;
+
+    // Packet gap in 10-bit characters
+    t = (uint32_t)((uint64_t)ch->packet_gap_chars * 10000000u / baud);
+    ch->packet_gap_us = t < UART_BRIDGE_IDLE_MIN_US ? UART_BRIDGE_IDLE_MIN_US : t;
+}
+
+// RTS is active low
+static void set_rts(bridge_channel_t *ch, bool assert) {
+    if (assert == ch->rts_asserted) return;
+    ch->rts_asserted = assert;
+    gpio_put(UART_BRIDGE_RTS_PIN, !assert);
+    if (!assert) ch->stats.throttles++;
+    ch->stats.rts_asserted = assert;
+}
+
+// uart_init() resets the block, so error interrupts are re-enabled here
+// (it sets DMACR itself)
+static void configure_uart(bridge_channel_t *ch, uint baud) {
+    uart_init(ch->uart, baud);
+    uart_hw_t *hw = uart_get_hw(ch->uart);
+    hw->icr = UART_UARTMIS_OEMIS_BITS | UART_UARTMIS_FEMIS_BITS |
+              UART_UARTMIS_PEMIS_BITS | UART_UARTMIS_BEMIS_BITS;
+    hw->imsc = UART_UARTIMSC_OEIM_BITS | UART_UARTIMSC_FEIM_BITS |
+               UART_UARTIMSC_PEIM_BITS | UART_UARTIMSC_BEIM_BITS;
+    if (ch->flow_control) {
+        uart_set_hw_flow(ch->uart, true, false);
+    }
+}
+
+static void attach_hw_uart(bridge_channel_t *ch, uint baud) {
+    configure_uart(ch, baud);
+    gpio_set_function(ch->tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(ch->rx_pin, GPIO_FUNC_UART);
+    if (ch->flow_control) {
+        gpio_set_function(UART_BRIDGE_CTS_PIN, GPIO_FUNC_UART);
+    }
+}
+
+static bool init_backend(bridge_channel_t *ch) {
+    if (ch->backend == BACKEND_PIO) {
+        if (!pio_uart_init(&ch->pio, UART_BRIDGE_PIO, ch->tx_pin, ch->rx_pin)) return false;
+        pio_uart_set_baud(&ch->pio, UART_BRIDGE_DEFAULT_BAUD);
+        pio_uart_set_enabled(&ch->pio, true);
+        ch->active = BACKEND_PIO;
+        return true;
+    }
+
+    if (ch->pio_fallback &&
+        !pio_uart_init(&ch->pio, UART_BRIDGE_FALLBACK_PIO, ch->tx_pin, ch->rx_pin)) {
+        LOG_WARN("UART bridge %s: no PIO fallback", ch->name);
+        ch->pio_fallback = false;
+    }
+
+    uint idx = uart_get_index(ch->uart);
+    uart_irq_channel[idx] = ch;
+    uint irq = idx ? UART1_IRQ : UART0_IRQ;
+    irq_set_exclusive_handler(irq, idx ? uart1_error_irq_handler : uart0_error_irq_handler);
+    irq_set_enabled(irq, true);
+
+    attach_hw_uart(ch, UART_BRIDGE_DEFAULT_BAUD);
+    ch->active = BACKEND_HW;
+
+    if (ch->flow_control) {
+        gpio_pull_down(UART_BRIDGE_CTS_PIN);  // unconnected CTS means clear to send
+        gpio_init(UART_BRIDGE_RTS_PIN);
+        gpio_put(UART_BRIDGE_RTS_PIN, 1);  // deasserted until the host is ready
+        gpio_set_dir(UART_BRIDGE_RTS_PIN, GPIO_OUT);
+        LOG_INFO("UART flow control: CTS GPIO%d, RTS GPIO%d", UART_BRIDGE_CTS_PIN, UART_BRIDGE_RTS_PIN);
+    }
+    return true;
+}
+
+// Points both DMA channels at the active backend and restarts RX at the
+// top of the ring
+static void attach_dma(bridge_channel_t *ch) {
+    const volatile void *rx_src;
+    volatile void *tx_dst;
+    uint rx_dreq, tx_dreq;
+
+    if (ch->active == BACKEND_PIO) {
+        rx_src = pio_uart_rx_fifo(&ch->pio);
+        tx_dst = pio_uart_tx_fifo(&ch->pio);
+        rx_dreq = pio_uart_get_dreq(&ch->pio, false);
+        tx_dreq = pio_uart_get_dreq(&ch->pio, true);
+    } else {
+        rx_src = &uart_get_hw(ch->uart)->dr;
+        tx_dst = &uart_get_hw(ch->uart)->dr;
+        rx_dreq = uart_get_dreq(ch->uart, false);
+        tx_dreq = uart_get_dreq(ch->uart, true);
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(ch->dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, UART_BRIDGE_RX_RING_BITS);
+    channel_config_set_dreq(&c, rx_dreq);
+    dma_channel_set_irq1_enabled(ch->dma_rx, true);
+    dma_channel_configure(ch->dma_rx, &c, ch->ring, rx_src, RX_HALF, true);
+
+    c = dma_channel_get_default_config(ch->dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, tx_dreq);
+    dma_channel_configure(ch->dma_tx, &c, tx_dst, ch->tx_buf, 0, false);
+}
+
+void uart_bridge_init(void) {
+    irq_add_shared_handler(DMA_IRQ_1, dma_rx_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+
+    for (int i = 0; i < UART_BRIDGE_CHANNELS; i++) {
+        bridge_channel_t *ch = &channels[i];
+        ch->dma_rx = -1;
+        ch->ring = rx_rings[i];
+        ch->tx_buf = tx_bufs[i];
+        ch->stats.baud_rate = UART_BRIDGE_DEFAULT_BAUD;
+        ch->stats.data_bits = 8;
+        ch->stats.stop_bits = 1;
+        ch->packet_gap_chars = UART_BRIDGE_PACKET_GAP_CHARS;
+        ch->packet_to_stream = UART_BRIDGE_PACKET_STREAM;
+
+        if (!init_backend(ch)) {
+            LOG_ERROR("UART bridge %s: no free PIO resources", ch->name);
+            continue;
+        }
+        update_idle_time(ch);
+        ch->dma_rx = dma_claim_unused_channel(true);
+        ch->dma_tx = dma_claim_unused_channel(true);
+        attach_dma(ch);
+    }
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    ram_budget_add("UART RX rings + TX buffers",
+                   sizeof(rx_rings) + sizeof(tx_bufs) + sizeof(packet_buf));
+}
+
+// Total bytes the RX DMA has written since init
+static uint32_t rx_written(bridge_channel_t *ch) {
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t remaining = dma_channel_hw_addr(ch->dma_rx)->transfer_count;
+    uint32_t halves = ch->rx_halves;
+    restore_interrupts(ints);
+    return halves * RX_HALF + (RX_HALF - remaining);
+}
+
+static void copy_from_ring(bridge_channel_t *ch, uint8_t *dst, uint32_t len) {
+    uint32_t pos = ch->rx_read & (UART_BRIDGE_RX_RING_SIZE - 1);
+    uint32_t first = UART_BRIDGE_RX_RING_SIZE - pos;
+    if (first > len) first = len;
+    memcpy(dst, &ch->ring[pos], first);
+    memcpy(dst + first, ch->ring, len - first);
+}
+
+// Packet mode: hold RX bytes until the line has been quiet for the gap (or
+// a packet's worth has built up) and send them as one write, so message
+// boundaries survive and USB packets are full
+static void packet_task(bridge_channel_t *ch, uint32_t pending, uint32_t now) {
+    if (pending == 0) return;
+
+    bool to_stream = ch->packet_to_stream && usb_stream_active();
+    uint32_t limit = to_stream ? STREAM_PACKET_LIMIT : CDC_PACKET_LIMIT;
+    bool idle = now - ch->rx_last_change_us >= ch->packet_gap_us;
+    if (!idle && pending < limit) return;
+
+    uint32_t len = pending < limit ? pending : limit;
+    if (to_stream) {
+        if (usb_stream_space() < (int)(UART_PACKET_HEADER + len)) return;
+        uint32_t ts = ch->packet_start_us;
+        packet_buf[0] = (uint8_t)(ch - channels);
+        packet_buf[1] = ts & 0xFF;
+        packet_buf[2] = (ts >> 8) & 0xFF;
+        packet_buf[3] = (ts >> 16) & 0xFF;
+        packet_buf[4] = (ts >> 24) & 0xFF;
+        copy_from_ring(ch, &packet_buf[UART_PACKET_HEADER], len);
+        usb_stream_write_record(STREAM_REC_UART, packet_buf, UART_PACKET_HEADER + len);
+    } else {
+        if (tud_cdc_n_write_available(ch->cdc_itf) < len) return;
+        copy_from_ring(ch, packet_buf, len);
+        tud_cdc_n_write(ch->cdc_itf, packet_buf, len);
+        tud_cdc_n_write_flush(ch->cdc_itf);
+    }
+
+    ch->rx_read += len;
+    ch->stats.rx_bytes += len;
+    ch->stats.packets++;
+    if (len < pending) {
+        // Split at the size limit; the rest starts a new packet
+        ch->stats.packet_splits++;
+        ch->packet_start_us = now;
+    }
+}
+
+static void channel_task(bridge_channel_t *ch) {
+    uint8_t itf = ch->cdc_itf;
+    ch->stats.connected = tud_cdc_n_connected(itf) || tud_cdc_n_available(itf);
+
+    if (ch->active == BACKEND_PIO && pio_uart_take_framing_error(&ch->pio)) {
+        ch->stats.framing_errors++;
+    }
+
+    // CDC → UART: refill only once the previous block has gone out, so a
+    // slow baud rate never blocks the main loop
+    if (!dma_channel_is_busy(ch->dma_tx) && tud_cdc_n_available(itf)) {
+        uint32_t count = tud_cdc_n_read(itf, ch->tx_buf, UART_BRIDGE_TX_BUFFER_SIZE);
+        if (count > 0) {
+            dma_channel_transfer_from_buffer_now(ch->dma_tx, ch->tx_buf, count);
+            ch->stats.tx_bytes += count;
+        }
+    }
+
+    // UART → CDC (send if USB is mounted, regardless of DTR)
+    uint32_t now = time_us_32();
+    uint32_t written = rx_written(ch);
+    if (written != ch->rx_last_written) {
+        if (ch->rx_last_written == ch->rx_read) ch->packet_start_us = now;
+        ch->rx_last_written = written;
+        ch->rx_last_change_us = now;
+    }
+
+    uint32_t pending = written - ch->rx_read;
+    if (pending > UART_BRIDGE_RX_RING_SIZE - RX_MARGIN) {
+        uint32_t skip = pending - (UART_BRIDGE_RX_RING_SIZE - RX_MARGIN);
+        ch->stats.dropped += skip;
+        ch->rx_read += skip;
+        pending -= skip;
+    }
+
+    if (ch->flow_control) {
+        // Hold the target off while the ring is filling up or the host has
+        // dropped RTS; data stays in the ring instead of being discarded
+        bool host_rts = tud_mounted() && (tud_cdc_n_get_line_state(itf) & 0x02);
+        if (!host_rts || pending >= UART_BRIDGE_RTS_HIGH_WATER) {
+            set_rts(ch, false);
+        } else if (pending <= UART_BRIDGE_RTS_LOW_WATER) {
+            set_rts(ch, true);
+        }
+        if (!tud_mounted()) return;
+    } else if (!tud_mounted()) {
+        // Drain UART when USB not connected
+        ch->rx_read = written;
+        return;
+    }
+
+    if (ch->packet_gap_chars) {
+        packet_task(ch, pending, now);
+        return;
+    }
+
+    uint32_t space = tud_cdc_n_write_available(itf);
+    uint32_t count = pending < space ? pending : space;
+    while (count > 0) {
+        uint32_t pos = ch->rx_read & (UART_BRIDGE_RX_RING_SIZE - 1);
+        uint32_t chunk = UART_BRIDGE_RX_RING_SIZE - pos;
+        if (chunk > count) chunk = count;
+        tud_cdc_n_write(itf, &ch->ring[pos], chunk);
+        ch->rx_read += chunk;
+        count -= chunk;
+        ch->stats.rx_bytes += chunk;
+        ch->rx_unflushed = true;
+    }
+
+    // TinyUSB sends full packets by itself; the tail goes out once the
+    // line goes quiet
+    if (ch->rx_unflushed && now - ch->rx_last_change_us >= ch->idle_us) {
+        tud_cdc_n_write_flush(itf);
+        ch->stats.idle_flushes++;
+        ch->rx_unflushed = false;
+    }
+}
+
+void uart_bridge_task(void) {
+    for (int i = 0; i < UART_BRIDGE_CHANNELS; i++) {
+        if (channels[i].dma_rx < 0) continue;
+        channel_task(&channels[i]);
+    }
+}
+
+uart_bridge_stats_t uart_bridge_get_stats(uint8_t channel) {
+    if (channel >= UART_BRIDGE_CHANNELS) return (uart_bridge_stats_t){0};
+    return channels[channel].stats;
+}
+
+void uart_bridge_reset_stats(void) {
+    for (int i = 0; i < UART_BRIDGE_CHANNELS; i++) {
+        uart_bridge_stats_t *st = &channels[i].stats;
+        uint32_t ints = save_and_disable_interrupts();
+        *st = (uart_bridge_stats_t){
+            .baud_rate = st->baud_rate,
+            .data_bits = st->data_bits,
+            .stop_bits = st->stop_bits,
+            .parity = st->parity,
+            .connected = st->connected,
+            .rts_asserted = st->rts_asserted,
+            .pio_backend = st->pio_backend,
+        };
+        restore_interrupts(ints);
+    }
+}
+
+void uart_bridge_set_packet_mode(uint8_t channel, uint8_t gap_chars, bool to_stream) {
+    if (channel >= UART_BRIDGE_CHANNELS) return;
+    bridge_channel_t *ch = &channels[channel];
+    ch->packet_gap_chars = gap_chars;
+    ch->packet_to_stream = to_stream;
+    update_idle_time(ch);
+}
+
+const char *uart_bridge_channel_name(uint8_t channel) {
+    if (channel >= UART_BRIDGE_CHANNELS) return "";
+    return channels[channel].name;
+}
+
+// Baud rate the PL011 divider actually produces for a request, using the
+// same arithmetic as uart_set_baudrate()
+static uint32_t hw_uart_actual_baud(uint32_t baud) {
+    uint32_t clk = clock_get_hz(clk_peri);
+    uint32_t div = (8 * clk / baud) + 1;
+    uint32_t ibrd = div >> 7;
+    uint32_t fbrd = (div & 0x7f) >> 1;
+
+    if (ibrd == 0) {
+        ibrd = 1;
+        fbrd = 0;
+    } else if (ibrd >= 65535) {
+        ibrd = 65535;
+        fbrd = 0;
+    }
+    return (4 * clk) / (64 * ibrd + fbrd);
+}
+
+static uint32_t baud_error_ppm(uint32_t actual, uint32_t requested) {
+    uint32_t diff = actual > requested ? actual - requested : requested - actual;
+    return (uint32_t)((uint64_t)diff * 1000000u / requested);
+}
+
+// Waits up to four character times at the current rate for the PL011 to
+// finish sending. uart_deinit() afterwards resets the block, dropping
+// anything still queued.
+static void drain_tx_fifo(bridge_channel_t *ch) {
+    uint32_t limit = 2 * ch->idle_us;
+    if (limit > UART_BRIDGE_DRAIN_MAX_US) limit = UART_BRIDGE_DRAIN_MAX_US;
+    uint32_t start = time_us_32();
+    while ((uart_get_hw(ch->uart)->fr & UART_UARTFR_BUSY_BITS) &&
+           time_us_32() - start < limit) {
+        tight_loop_contents();
+    }
+}
+
+// Moves a channel between its hardware UART and its PIO engine. RX data
+// still in flight is discarded; it was sent at the old rate anyway.
+static void select_backend(bridge_channel_t *ch, backend_t backend, uint32_t baud) {
+    if (backend == ch->active) return;
+
+    dma_channel_set_irq1_enabled(ch->dma_rx, false);
+    dma_channel_abort(ch->dma_rx);
+    dma_channel_acknowledge_irq1(ch->dma_rx);
+
+    if (backend == BACKEND_PIO) {
+        drain_tx_fifo(ch);
+        uart_deinit(ch->uart);
+        pio_uart_set_enabled(&ch->pio, true);
+    } else {
+        pio_uart_set_enabled(&ch->pio, false);
+        attach_hw_uart(ch, baud);
+    }
+    ch->active = backend;
+
+    ch->rx_halves = 0;
+    ch->rx_read = 0;
+    ch->rx_last_written = 0;
+    ch->rx_unflushed = false;
+    attach_dma(ch);
+
+    ch->stats.pio_backend = backend == BACKEND_PIO;
+    ch->stats.backend_switches++;
+    LOG_INFO("UART bridge %s: %s backend", ch->name, backend == BACKEND_PIO ? "PIO" : "hardware");
+}
+
+// TinyUSB line coding callback – update UART when host changes baud/format
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding) {
+    bridge_channel_t *ch = NULL;
+    for (int i = 0; i < UART_BRIDGE_CHANNELS; i++) {
+        if (channels[i].cdc_itf == itf) ch = &channels[i];
+    }
+    if (!ch || ch->dma_rx < 0 || p_line_coding->bit_rate == 0) return;
+
+    uint32_t baud = p_line_coding->bit_rate;
+
+    // Whatever is still queued for TX would go out in the wrong format
+    dma_channel_abort(ch->dma_tx);
+
+    // The PIO engine only does 8N1, so it takes over from the hardware UART
+    // only for rates the PL011 divider can't hit and a format it can run
+    bool use_pio = ch->backend == BACKEND_PIO;
+    if (!use_pio && ch->pio_fallback) {
+        bool is_8n1 = p_line_coding->data_bits == 8 && p_line_coding->parity == 0 &&
+                      p_line_coding->stop_bits == 0;
+        uint32_t err = baud_error_ppm(hw_uart_actual_baud(baud), baud);
+        if (err > UART_BRIDGE_BAUD_TOLERANCE_PPM) {
+            if (is_8n1) {
+                use_pio = true;
+            } else {
+                LOG_WARN("UART bridge %s: %lu baud is %lu ppm off and not 8N1",
+                         ch->name, (unsigned long)baud, (unsigned long)err);
+            }
+        }
+    }
+
+    if (use_pio) {
+        if (ch->backend == BACKEND_HW) select_backend(ch, BACKEND_PIO, baud);
+        // Report what is actually in use
+        ch->stats.baud_rate = pio_uart_set_baud(&ch->pio, baud);
+        ch->stats.data_bits = 8;
+        ch->stats.stop_bits = 1;
+        ch->stats.parity = 0;
+        update_idle_time(ch);
+        return;
+    }
+
+    ch->stats.baud_rate = baud;
+    ch->stats.data_bits = p_line_coding->data_bits;
+    ch->stats.stop_bits = p_line_coding->stop_bits;
+    ch->stats.parity = p_line_coding->parity;
+
+    if (ch->active == BACKEND_PIO) {
+        select_backend(ch, BACKEND_HW, baud);
+    } else {
+        drain_tx_fifo(ch);
+        uart_deinit(ch->uart);
+        configure_uart(ch, baud);
+    }
+    update_idle_time(ch);
+
+    uart_parity_t parity = UART_PARITY_NONE;
+    if (p_line_coding->parity == 1) parity = UART_PARITY_ODD;
+    else if (p_line_coding->parity == 2) parity = UART_PARITY_EVEN;
+
+    uint stop = (p_line_coding->stop_bits == 2) ? 2 : 1;
+    uint data = (p_line_coding->data_bits >= 5 && p_line_coding->data_bits <= 8)
+                    ? p_line_coding->data_bits : 8;
+
+    uart_set_format(ch->uart, data, stop, parity);
+}
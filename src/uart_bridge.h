@@ -0,0 +1,106 @@
+#ifndef UART_BRIDGE_H
+#define UART_BRIDGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_cdc.h"
+
+// Bridge channels, each on its own CDC interface (UART_BRIDGE_CHANNELS is
+// set in usb_cdc.h together with the interface layout):
+//   0: uart1 on GPIO4 (TX) / GPIO5 (RX)
+//   1: uart0 on GPIO0 (TX) / GPIO1 (RX)
+//   2: PIO UART (pio1) on GPIO20 (TX) / GPIO21 (RX), 8N1 only
+#define UART_BRIDGE_TX_PIN 4
+#define UART_BRIDGE_RX_PIN 5
+#define UART_BRIDGE1_TX_PIN 0
+#define UART_BRIDGE1_RX_PIN 1
+#define UART_BRIDGE2_TX_PIN 20
+#define UART_BRIDGE2_RX_PIN 21
+#define UART_BRIDGE_DEFAULT_BAUD 115200
+
+// The hardware channels switch to a PIO UART engine (8N1 only) when the
+// PL011 divider can't get within this tolerance of the requested baud rate,
+// e.g. above clk_peri / 16
+#ifndef UART_BRIDGE_PIO_FALLBACK
+#define UART_BRIDGE_PIO_FALLBACK 1
+#endif
+#ifndef UART_BRIDGE_BAUD_TOLERANCE_PPM
+#define UART_BRIDGE_BAUD_TOLERANCE_PPM 10000
+#endif
+
+// Optional RTS/CTS flow control on channel 0 (build with
+// -DUART_BRIDGE_FLOW_CONTROL=1). CTS uses the UART's own flow control, so
+// it must be a uart1 CTS pin (GPIO6, 22 or 26). RTS is driven in software
+// from the RX ring fill level and the host's RTS line state, so it can be
+// any free GPIO.
+#ifndef UART_BRIDGE_FLOW_CONTROL
+#define UART_BRIDGE_FLOW_CONTROL 0
+#endif
+#ifndef UART_BRIDGE_CTS_PIN
+#define UART_BRIDGE_CTS_PIN 6
+#endif
+#ifndef UART_BRIDGE_RTS_PIN
+#define UART_BRIDGE_RTS_PIN 7
+#endif
+
+// RX: DMA into a ring (2^bits bytes, aligned for DMA address wrapping).
+// TX: DMA from a linear buffer refilled from CDC whenever the channel is idle.
+#define UART_BRIDGE_RX_RING_BITS 12
+#define UART_BRIDGE_RX_RING_SIZE (1u << UART_BRIDGE_RX_RING_BITS)
+#define UART_BRIDGE_TX_BUFFER_SIZE 256
+
+// Partial USB packets are flushed once the line has been idle for two
+// character times, but never sooner than this
+#define UART_BRIDGE_IDLE_MIN_US 50
+
+// On a line coding change the TX FIFO gets a few character times (at most
+// this long) to drain; with CTS held off it never would, so the rest is
+// discarded rather than blocking the main loop
+#define UART_BRIDGE_DRAIN_MAX_US 5000
+
+// Packet mode: RX bytes are grouped by idle gaps of this many character
+// times and each group is sent as one USB write (0 = off). With
+// UART_BRIDGE_PACKET_STREAM, groups go to the vendor record stream with a
+// channel and timestamp header instead of the CDC port.
+#ifndef UART_BRIDGE_PACKET_GAP_CHARS
+#define UART_BRIDGE_PACKET_GAP_CHARS 0
+#endif
+#ifndef UART_BRIDGE_PACKET_STREAM
+#define UART_BRIDGE_PACKET_STREAM 0
+#endif
+#define UART_BRIDGE_PACKET_MAX 256
+
+// RTS is deasserted above the high mark and reasserted below the low mark
+#define UART_BRIDGE_RTS_HIGH_WATER (UART_BRIDGE_RX_RING_SIZE - 1024)
+#define UART_BRIDGE_RTS_LOW_WATER (UART_BRIDGE_RX_RING_SIZE / 4)
+
+typedef struct {
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t baud_rate;
+    uint8_t data_bits;
+    uint8_t stop_bits;
+    uint8_t parity;
+    bool connected;
+    uint32_t overruns;       // UART RX FIFO overrun (hardware)
+    uint32_t framing_errors;
+    uint32_t parity_errors;
+    uint32_t breaks;
+    uint32_t dropped;        // RX ring overwritten before USB drained it
+    uint32_t idle_flushes;
+    uint32_t throttles;      // times RTS was deasserted
+    bool rts_asserted;
+    bool pio_backend;        // running on the PIO engine
+    uint32_t backend_switches;
+    uint32_t packets;        // packet mode: groups sent
+    uint32_t packet_splits;  // groups cut at UART_BRIDGE_PACKET_MAX
+} uart_bridge_stats_t;
+
+void uart_bridge_init(void);
+void uart_bridge_task(void);
+uart_bridge_stats_t uart_bridge_get_stats(uint8_t channel);
+void uart_bridge_reset_stats(void);
+const char *uart_bridge_channel_name(uint8_t channel);
+void uart_bridge_set_packet_mode(uint8_t channel, uint8_t gap_chars, bool to_stream);
+
+#endif
@@ -0,0 +1,230 @@
+#include "usb_bench.h"
+#include "circular_buffer.h"
+#include "prbs.h"
+#include "ram_budget.h"
+#include "shell.h"
+#include "usb_cdc.h"
+#include "tusb.h"
+#include "pico/time.h"
+
+static usb_bench_stats_t stats = {0};
+static usb_bench_stats_t last_report = {0};
+static uint32_t start_ms = 0;
+static uint32_t last_report_ms = 0;
+static uint32_t duration_ms = 0;
+
+// Pattern generator (source) and checker (sink) state
+static uint32_t source_state = 0;
+static uint32_t sink_state = 0;
+
+static uint8_t ring_data[USB_BENCH_RING_SIZE];
+static circular_buffer_t ring;
+
+static bool stalled = false;
+static uint32_t stall_start_us = 0;
+
+static const char *const mode_names[] = {"off", "source", "sink", "loopback"};
+
+static uint32_t pattern_seed(void) {
+    return stats.pattern == BENCH_PATTERN_PRBS ? PRBS_SEED : 0;
+}
+
+static uint8_t pattern_next(uint32_t *state) {
+    if (stats.pattern == BENCH_PATTERN_PRBS) return prbs_next(state);
+    return (uint8_t)(*state)++;
+}
+
+static void check_byte(uint8_t data) {
+    uint8_t expected = pattern_next(&sink_state);
+    if (data == expected) return;
+
+    stats.errors++;
+    // Resynchronize on the received stream: the counter restarts from the
+    // byte seen, and PRBS state is rebuilt from received bytes within four
+    if (stats.pattern == BENCH_PATTERN_PRBS) {
+        sink_state = (sink_state & ~0xFFu) | data;
+    } else {
+        sink_state = (uint8_t)(data + 1);
+    }
+}
+
+static void update_stall(bool blocked) {
+    uint32_t now = time_us_32();
+    if (blocked && !stalled) {
+        stalled = true;
+        stall_start_us = now;
+        stats.stalls++;
+    } else if (!blocked && stalled) {
+        stalled = false;
+        stats.stall_us += now - stall_start_us;
+    }
+}
+
+static void run_source(void) {
+    uint32_t space = tud_cdc_n_write_available(CDC_ITF_DATA);
+    update_stall(space == 0);
+
+    uint8_t buf[USB_CDC_PACKET_SIZE];
+    while (space > 0) {
+        uint32_t n = space < sizeof(buf) ? space : sizeof(buf);
+        for (uint32_t i = 0; i < n; i++) {
+            buf[i] = pattern_next(&source_state);
+        }
+        tud_cdc_n_write(CDC_ITF_DATA, buf, n);
+        stats.tx_bytes += n;
+        space -= n;
+    }
+    tud_cdc_n_write_flush(CDC_ITF_DATA);
+}
+
+static void run_sink(void) {
+    uint8_t buf[USB_CDC_PACKET_SIZE];
+    uint32_t n;
+    while ((n = tud_cdc_n_read(CDC_ITF_DATA, buf, sizeof(buf))) > 0) {
+        for (uint32_t i = 0; i < n; i++) {
+            check_byte(buf[i]);
+        }
+        stats.rx_bytes += n;
+    }
+}
+
+// Same path as console data: bytes go through a circular buffer between
+// the USB read and the USB write
+static void run_loopback(void) {
+    uint8_t buf[USB_CDC_PACKET_SIZE];
+
+    while (circular_buffer_free(&ring) > 0 && tud_cdc_n_available(CDC_ITF_DATA)) {
+        uint32_t max = circular_buffer_free(&ring);
+        if (max > sizeof(buf)) max = sizeof(buf);
+        uint32_t n = tud_cdc_n_read(CDC_ITF_DATA, buf, max);
+        if (n == 0) break;
+        circular_buffer_write(&ring, buf, n);
+        stats.rx_bytes += n;
+    }
+
+    uint32_t space = tud_cdc_n_write_available(CDC_ITF_DATA);
+    update_stall(circular_buffer_available(&ring) > 0 && space == 0);
+    while (space > 0 && circular_buffer_available(&ring) > 0) {
+        uint32_t max = space < sizeof(buf) ? space : sizeof(buf);
+        uint32_t n = circular_buffer_read(&ring, buf, max);
+        tud_cdc_n_write(CDC_ITF_DATA, buf, n);
+        stats.tx_bytes += n;
+        space -= n;
+    }
+    tud_cdc_n_write_flush(CDC_ITF_DATA);
+}
+
+static uint32_t rate(uint32_t bytes, uint32_t ms) {
+    return ms ? (uint32_t)((uint64_t)bytes * 1000 / ms) : 0;
+}
+
+static void report(void) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    uint32_t ms = now - last_report_ms;
+    last_report_ms = now;
+
+    shell_printf("bench %s: tx %lu B/s, rx %lu B/s, %lu transfers, %lu packets, %lu stalls, %lu errors\n",
+                 mode_names[stats.mode],
+                 (unsigned long)rate(stats.tx_bytes - last_report.tx_bytes, ms),
+                 (unsigned long)rate(stats.rx_bytes - last_report.rx_bytes, ms),
+                 (unsigned long)(stats.tx_transfers - last_report.tx_transfers),
+                 (unsigned long)(stats.rx_packets - last_report.rx_packets),
+                 (unsigned long)(stats.stalls - last_report.stalls),
+                 (unsigned long)(stats.errors - last_report.errors));
+    last_report = stats;
+}
+
+void usb_bench_init(void) {
+    circular_buffer_init(&ring, ring_data, USB_BENCH_RING_SIZE);
+    ram_budget_add("USB bench ring", USB_BENCH_RING_SIZE);
+}
+
+void usb_bench_start(usb_bench_mode_t mode, usb_bench_pattern_t pattern, uint32_t duration_s) {
+    if (stats.mode != BENCH_OFF) usb_bench_stop();
+    if (mode == BENCH_OFF) return;
+
+    stats = (usb_bench_stats_t){.mode = mode, .pattern = pattern};
+    last_report = stats;
+    source_state = pattern_seed();
+    sink_state = pattern_seed();
+    circular_buffer_clear(&ring);
+    stalled = false;
+
+    // Drop console leftovers so they don't count against the pattern
+    tud_cdc_n_read_flush(CDC_ITF_DATA);
+
+    start_ms = to_ms_since_boot(get_absolute_time());
+    last_report_ms = start_ms;
+    duration_ms = duration_s * 1000;
+    shell_printf("bench %s started\n", mode_names[mode]);
+}
+
+void usb_bench_stop(void) {
+    if (stats.mode == BENCH_OFF) return;
+
+    update_stall(false);
+    stats.elapsed_ms = to_ms_since_boot(get_absolute_time()) - start_ms;
+    shell_printf("bench %s done: %lu ms, tx %lu bytes (%lu B/s), rx %lu bytes (%lu B/s)\n",
+                 mode_names[stats.mode], (unsigned long)stats.elapsed_ms,
+                 (unsigned long)stats.tx_bytes, (unsigned long)rate(stats.tx_bytes, stats.elapsed_ms),
+                 (unsigned long)stats.rx_bytes, (unsigned long)rate(stats.rx_bytes, stats.elapsed_ms));
+    shell_printf("  %lu transfers, %lu packets, %lu stalls (%lu us), %lu errors\n",
+                 (unsigned long)stats.tx_transfers, (unsigned long)stats.rx_packets,
+                 (unsigned long)stats.stalls, (unsigned long)stats.stall_us,
+                 (unsigned long)stats.errors);
+
+    // Unsent pattern data would otherwise lead the console output
+    tud_cdc_n_write_clear(CDC_ITF_DATA);
+    stats.mode = BENCH_OFF;
+}
+
+void usb_bench_task(void) {
+    if (stats.mode == BENCH_OFF) return;
+
+    switch (stats.mode) {
+    case BENCH_SOURCE:
+        run_source();
+        break;
+    case BENCH_SINK:
+        run_sink();
+        break;
+    case BENCH_LOOPBACK:
+        run_loopback();
+        break;
+    default:
+        break;
+    }
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (duration_ms && now - start_ms >= duration_ms) {
+        usb_bench_stop();
+    } else if (now - last_report_ms >= USB_BENCH_REPORT_INTERVAL_MS) {
+        report();
+    }
+}
+
+bool usb_bench_active(void) {
+    return stats.mode != BENCH_OFF;
+}
+
+usb_bench_stats_t usb_bench_get_stats(void) {
+    usb_bench_stats_t st = stats;
+    if (st.mode != BENCH_OFF) {
+        st.elapsed_ms = to_ms_since_boot(get_absolute_time()) - start_ms;
+    }
+    return st;
+}
+
+const char *usb_bench_mode_name(usb_bench_mode_t mode) {
+    return mode <= BENCH_LOOPBACK ? mode_names[mode] : "?";
+}
+
+// TinyUSB callbacks: one per OUT packet and per completed IN transfer
+void tud_cdc_rx_cb(uint8_t itf) {
+    if (itf == CDC_ITF_DATA && stats.mode != BENCH_OFF) stats.rx_packets++;
+}
+
+void tud_cdc_tx_complete_cb(uint8_t itf) {
+    usb_cdc_tx_complete(itf);
+    if (itf == CDC_ITF_DATA && stats.mode != BENCH_OFF) stats.tx_transfers++;
+}
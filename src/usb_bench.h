@@ -0,0 +1,49 @@
+#ifndef USB_BENCH_H
+#define USB_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// USB benchmark on CDC0. While a mode runs it owns CDC0 and the console
+// pump is paused.
+//   source:   device sends the pattern as fast as USB takes it
+//   sink:     device checks host data against the pattern
+//   loopback: CDC0 input goes through a ring and straight back out
+#define USB_BENCH_RING_SIZE 4096
+#define USB_BENCH_REPORT_INTERVAL_MS 1000
+
+typedef enum {
+    BENCH_OFF = 0,
+    BENCH_SOURCE,
+    BENCH_SINK,
+    BENCH_LOOPBACK
+} usb_bench_mode_t;
+
+typedef enum {
+    BENCH_PATTERN_COUNTER = 0,  // 0x00, 0x01, ... 0xFF, 0x00, ...
+    BENCH_PATTERN_PRBS          // PRBS31 from PRBS_SEED, as for REG_PRBS_*
+} usb_bench_pattern_t;
+
+typedef struct {
+    usb_bench_mode_t mode;
+    usb_bench_pattern_t pattern;
+    uint32_t elapsed_ms;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t tx_transfers;   // completed IN transfers
+    uint32_t rx_packets;     // OUT packets received
+    uint32_t stalls;         // times the device had data but USB had no room
+    uint32_t stall_us;       // total time spent stalled
+    uint32_t errors;         // sink: bytes that didn't match the pattern
+} usb_bench_stats_t;
+
+void usb_bench_init(void);
+void usb_bench_task(void);
+// duration_s = 0 runs until usb_bench_stop()
+void usb_bench_start(usb_bench_mode_t mode, usb_bench_pattern_t pattern, uint32_t duration_s);
+void usb_bench_stop(void);
+bool usb_bench_active(void);
+usb_bench_stats_t usb_bench_get_stats(void);
+const char *usb_bench_mode_name(usb_bench_mode_t mode);
+
+#endif
@@ -1,23 +1,18 @@
 #include "usb_cdc.h"
 #include "tusb.h"
-#include "pico/bootrom.h"
-#include "hardware/uart.h"
-#include "hardware/gpio.h"
+#include "pico/time.h"
 #include <string.h>
 
-#define UART_BRIDGE_INST uart1
-#define UART_BRIDGE_DEFAULT_BAUD 115200
-
-static uint8_t cmd_buffer[64];
-static int cmd_len = 0;
-static bool last_dtr_state = false;
-
-static uart_bridge_stats_t bridge_stats = {
-    .baud_rate = UART_BRIDGE_DEFAULT_BAUD,
-    .data_bits = 8,
-    .stop_bits = 1,
-    .parity = 0,
+static usb_cdc_flush_policy_t flush_policy = {
+    .flush_on_newline = true,
+    .idle_flush_us = USB_CDC_IDLE_FLUSH_US,
+    .throughput_backlog = USB_CDC_THROUGHPUT_BACKLOG,
 };
+static usb_cdc_flush_stats_t flush_stats = {0};
+// Bytes written to CDC0 since the last packet boundary
+static uint32_t partial_bytes = 0;
+static bool newline_pending = false;
+static uint32_t last_write_us = 0;
 
 void usb_cdc_init(void) {
     tusb_init();
@@ -38,109 +33,90 @@ int usb_cdc_read(uint8_t *buffer, int len) {
 
 int usb_cdc_write(const uint8_t *buffer, int len) {
     if (!tud_cdc_n_connected(CDC_ITF_DATA)) return 0;
-    return tud_cdc_n_write(CDC_ITF_DATA, buffer, len);
-}
-
-void usb_cdc_check_bootloader_cmd(void) {
-    if (tud_cdc_n_connected(CDC_ITF_DEBUG)) {
-        bool dtr = tud_cdc_n_get_line_state(CDC_ITF_DEBUG) & 0x01;
-        if (last_dtr_state && !dtr) {
-            reset_usb_boot(0, 0);
-        }
-        last_dtr_state = dtr;
-    }
-
-    if (!tud_cdc_n_available(CDC_ITF_DEBUG)) return;
-
-    while (tud_cdc_n_available(CDC_ITF_DEBUG) && cmd_len < (int)sizeof(cmd_buffer) - 1) {
-        uint8_t c;
-        tud_cdc_n_read(CDC_ITF_DEBUG, &c, 1);
-
-        if (c == '\n' || c == '\r') {
-            if (cmd_len > 0) {
-                cmd_buffer[cmd_len] = '\0';
-                if (strcmp((char *)cmd_buffer, "BOOTLOADER") == 0 ||
-                    strcmp((char *)cmd_buffer, "bootloader") == 0 ||
-                    strcmp((char *)cmd_buffer, "reboot") == 0) {
-                    tud_cdc_n_write_str(CDC_ITF_DEBUG, "Entering bootloader mode...\n");
-                    tud_cdc_n_write_flush(CDC_ITF_DEBUG);
-                    sleep_ms(100);
-                    reset_usb_boot(0, 0);
-                }
-                cmd_len = 0;
-            }
-        } else {
-            cmd_buffer[cmd_len++] = c;
-        }
+    int written = tud_cdc_n_write(CDC_ITF_DATA, buffer, len);
+    if (written <= 0) return written;
+
+    // TinyUSB starts a transfer by itself once a full packet is queued
+    flush_stats.bytes += written;
+    partial_bytes = (partial_bytes + written) % USB_CDC_PACKET_SIZE;
+    if (flush_policy.flush_on_newline && memchr(buffer, '\n', written)) {
+        newline_pending = true;
     }
+    last_write_us = time_us_32();
+    return written;
+}
 
-    if (cmd_len >= (int)sizeof(cmd_buffer) - 1) cmd_len = 0;
+int usb_cdc_write_available(void) {
+    if (!tud_cdc_n_connected(CDC_ITF_DATA)) return 0;
+    return tud_cdc_n_write_available(CDC_ITF_DATA);
 }
 
-// --- UART Bridge ---
+// Only counted when it actually started a transfer; with one already in
+// flight TinyUSB sends the tail itself once that completes
+static void flush_partial(uint32_t *counter) {
+    partial_bytes = 0;
+    newline_pending = false;
+    if (tud_cdc_n_write_flush(CDC_ITF_DATA) > 0) (*counter)++;
+}
 
-void uart_bridge_init(void) {
-    uart_init(UART_BRIDGE_INST, UART_BRIDGE_DEFAULT_BAUD);
-    gpio_set_function(UART_BRIDGE_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(UART_BRIDGE_RX_PIN, GPIO_FUNC_UART);
+void usb_cdc_flush(void) {
+    flush_partial(&flush_stats.forced_flushes);
 }
 
-void uart_bridge_task(void) {
-    bridge_stats.connected = tud_cdc_n_connected(CDC_ITF_UART) || tud_cdc_n_available(CDC_ITF_UART);
+// Called once per main loop pass with the number of console bytes still
+// waiting to be written to CDC0
+void usb_cdc_flush_task(uint32_t backlog) {
+    bool throughput = backlog >= flush_policy.throughput_backlog;
+    if (throughput && !flush_stats.throughput_mode) flush_stats.throughput_switches++;
+    flush_stats.throughput_mode = throughput;
 
-    // CDC → UART
-    if (tud_cdc_n_available(CDC_ITF_UART)) {
-        uint8_t buf[64];
-        uint32_t count = tud_cdc_n_read(CDC_ITF_UART, buf, sizeof(buf));
-        for (uint32_t i = 0; i < count; i++) {
-            uart_putc_raw(UART_BRIDGE_INST, buf[i]);
-        }
-        bridge_stats.tx_bytes += count;
+    if (partial_bytes == 0) {
+        newline_pending = false;
+        return;
     }
+    // More data is on its way; let it fill the packet
+    if (throughput) return;
 
-    // UART → CDC (send if USB is mounted, regardless of DTR)
-    if (tud_mounted()) {
-        int count = 0;
-        while (uart_is_readable(UART_BRIDGE_INST) && count < 64) {
-            uint8_t c = uart_getc(UART_BRIDGE_INST);
-            tud_cdc_n_write(CDC_ITF_UART, &c, 1);
-            count++;
-        }
-        if (count > 0) {
-            tud_cdc_n_write_flush(CDC_ITF_UART);
-            bridge_stats.rx_bytes += count;
-        }
-    } else {
-        // Drain UART when USB not connected
-        while (uart_is_readable(UART_BRIDGE_INST)) {
-            uart_getc(UART_BRIDGE_INST);
-        }
+    if (newline_pending) {
+        flush_partial(&flush_stats.newline_flushes);
+    } else if (time_us_32() - last_write_us >= flush_policy.idle_flush_us) {
+        flush_partial(&flush_stats.idle_flushes);
     }
 }
 
-uart_bridge_stats_t uart_bridge_get_stats(void) {
-    return bridge_stats;
+void usb_cdc_set_flush_policy(const usb_cdc_flush_policy_t *policy) {
+    flush_policy = *policy;
+}
+
+usb_cdc_flush_policy_t usb_cdc_get_flush_policy(void) {
+    return flush_policy;
 }
 
-// TinyUSB line coding callback – update UART when host changes baud/format
-void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding) {
-    if (itf != CDC_ITF_UART) return;
+// From tud_cdc_tx_complete_cb(), once per completed IN transfer
+void usb_cdc_tx_complete(uint8_t itf) {
+    if (itf == CDC_ITF_DATA) flush_stats.packets++;
+}
 
-    bridge_stats.baud_rate = p_line_coding->bit_rate;
-    bridge_stats.data_bits = p_line_coding->data_bits;
-    bridge_stats.stop_bits = p_line_coding->stop_bits;
-    bridge_stats.parity = p_line_coding->parity;
+usb_cdc_flush_stats_t usb_cdc_get_flush_stats(void) {
+    return flush_stats;
+}
 
-    uart_deinit(UART_BRIDGE_INST);
-    uart_init(UART_BRIDGE_INST, p_line_coding->bit_rate);
+void usb_cdc_reset_flush_stats(void) {
+    flush_stats = (usb_cdc_flush_stats_t){.throughput_mode = flush_stats.throughput_mode};
+}
 
-    uart_parity_t parity = UART_PARITY_NONE;
-    if (p_line_coding->parity == 1) parity = UART_PARITY_ODD;
-    else if (p_line_coding->parity == 2) parity = UART_PARITY_EVEN;
+bool usb_cdc_n_connected(uint8_t itf) {
+    return tud_cdc_n_connected(itf);
+}
 
-    uint stop = (p_line_coding->stop_bits == 2) ? 2 : 1;
-    uint data = (p_line_coding->data_bits >= 5 && p_line_coding->data_bits <= 8)
-                    ? p_line_coding->data_bits : 8;
+int usb_cdc_n_write_available(uint8_t itf) {
+    if (!tud_cdc_n_connected(itf)) return 0;
+    return tud_cdc_n_write_available(itf);
+}
 
-    uart_set_format(UART_BRIDGE_INST, data, stop, parity);
+int usb_cdc_n_write(uint8_t itf, const uint8_t *buffer, int len) {
+    if (!tud_cdc_n_connected(itf)) return 0;
+    int written = tud_cdc_n_write(itf, buffer, len);
+    tud_cdc_n_write_flush(itf);
+    return written;
 }
@@ -4,32 +4,77 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Extra UART bridge channels and the sniffer compete for USB endpoint
+// numbers: three bridge channels only fit with the sniffer left out
+#ifndef UART_BRIDGE_CHANNELS
+#define UART_BRIDGE_CHANNELS 2
+#endif
+#ifndef I2CONSOLE_SNIFFER
+#define I2CONSOLE_SNIFFER 1
+#endif
+// Read-only history drive (see usb_msc.h); takes the last endpoint number
+#ifndef I2CONSOLE_MSC
+#define I2CONSOLE_MSC 0
+#endif
+
+#if UART_BRIDGE_CHANNELS < 1 || UART_BRIDGE_CHANNELS > 3
+#error "UART_BRIDGE_CHANNELS must be 1, 2 or 3"
+#endif
+#if I2CONSOLE_SNIFFER && UART_BRIDGE_CHANNELS > 2
+#error "A third UART bridge channel needs the sniffer disabled"
+#endif
+
 #define CDC_ITF_DATA  0
 #define CDC_ITF_UART  1
 #define CDC_ITF_DEBUG 2
+#if I2CONSOLE_SNIFFER
+#define CDC_ITF_SNIFFER 3
+#define CDC_ITF_TELEMETRY 4
+#else
+#define CDC_ITF_TELEMETRY 3
+#endif
+// Bridge channels 1 and 2 follow the telemetry interface
+#define CDC_ITF_UART_EXTRA (CDC_ITF_TELEMETRY + 1)
+#define CDC_ITF_COUNT (CDC_ITF_UART_EXTRA + UART_BRIDGE_CHANNELS - 1)
 
-#define UART_BRIDGE_TX_PIN 4
-#define UART_BRIDGE_RX_PIN 5
+// CDC0 flush policy. Below the backlog threshold the console runs in
+// latency mode: partial packets go out on newline or after the idle
+// timeout. Above it only full packets are sent until the backlog drains.
+#define USB_CDC_PACKET_SIZE 64
+#define USB_CDC_IDLE_FLUSH_US 300
+#define USB_CDC_THROUGHPUT_BACKLOG 128
 
 typedef struct {
-    uint32_t tx_bytes;
-    uint32_t rx_bytes;
-    uint32_t baud_rate;
-    uint8_t data_bits;
-    uint8_t stop_bits;
-    uint8_t parity;
-    bool connected;
-} uart_bridge_stats_t;
+    bool flush_on_newline;
+    uint32_t idle_flush_us;
+    uint32_t throughput_backlog;  // bytes queued before switching modes
+} usb_cdc_flush_policy_t;
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t packets;           // completed IN transfers (one packet each)
+    uint32_t newline_flushes;
+    uint32_t idle_flushes;
+    uint32_t forced_flushes;    // usb_cdc_flush()
+    uint32_t throughput_switches;
+    bool throughput_mode;
+} usb_cdc_flush_stats_t;
 
 void usb_cdc_init(void);
 void usb_cdc_task(void);
 bool usb_cdc_connected(void);
 int usb_cdc_read(uint8_t *buffer, int len);
 int usb_cdc_write(const uint8_t *buffer, int len);
-void usb_cdc_check_bootloader_cmd(void);
-
-void uart_bridge_init(void);
-void uart_bridge_task(void);
-uart_bridge_stats_t uart_bridge_get_stats(void);
+int usb_cdc_write_available(void);
+void usb_cdc_flush(void);
+void usb_cdc_flush_task(uint32_t backlog);
+void usb_cdc_set_flush_policy(const usb_cdc_flush_policy_t *policy);
+usb_cdc_flush_policy_t usb_cdc_get_flush_policy(void);
+void usb_cdc_tx_complete(uint8_t itf);
+usb_cdc_flush_stats_t usb_cdc_get_flush_stats(void);
+void usb_cdc_reset_flush_stats(void);
+bool usb_cdc_n_connected(uint8_t itf);
+int usb_cdc_n_write(uint8_t itf, const uint8_t *buffer, int len);
+int usb_cdc_n_write_available(uint8_t itf);
 
 #endif
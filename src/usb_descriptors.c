@@ -7,7 +7,7 @@
 tusb_desc_device_t const desc_device = {
     .bLength = sizeof(tusb_desc_device_t),
     .bDescriptorType = TUSB_DESC_DEVICE,
-    .bcdUSB = 0x0200,
+    .bcdUSB = 0x0210,  // 2.1 for the BOS descriptor (WinUSB)
     .bDeviceClass = TUSB_CLASS_MISC,
     .bDeviceSubClass = MISC_SUBCLASS_COMMON,
     .bDeviceProtocol = MISC_PROTOCOL_IAD,
@@ -32,10 +32,34 @@ enum {
     ITF_NUM_CDC_1_DATA,
     ITF_NUM_CDC_2,
     ITF_NUM_CDC_2_DATA,
+#if I2CONSOLE_SNIFFER
+    ITF_NUM_CDC_SNIFFER,
+    ITF_NUM_CDC_SNIFFER_DATA,
+#endif
+    ITF_NUM_CDC_TELEMETRY,
+    ITF_NUM_CDC_TELEMETRY_DATA,
+#if UART_BRIDGE_CHANNELS > 1
+    ITF_NUM_CDC_UART2,
+    ITF_NUM_CDC_UART2_DATA,
+#endif
+#if UART_BRIDGE_CHANNELS > 2
+    ITF_NUM_CDC_UART3,
+    ITF_NUM_CDC_UART3_DATA,
+#endif
+    ITF_NUM_VENDOR_ADAPTER,
+    ITF_NUM_VENDOR_STREAM,
+#if I2CONSOLE_MSC
+    ITF_NUM_MSC,
+#endif
     ITF_NUM_TOTAL
 };
 
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN * 3)
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN * CFG_TUD_CDC + \
+                          TUD_VENDOR_DESC_LEN * CFG_TUD_VENDOR + TUD_MSC_DESC_LEN * CFG_TUD_MSC)
+
+// Each CDC takes two endpoint numbers (notification + data pair) and each
+// vendor or MSC interface one, out of the 15 available beyond EP0
+_Static_assert(2 * CFG_TUD_CDC + CFG_TUD_VENDOR + CFG_TUD_MSC <= 15, "USB endpoint numbers exhausted");
 
 #define EPNUM_CDC_0_NOTIF 0x81
 #define EPNUM_CDC_0_OUT   0x02
@@ -46,12 +70,43 @@ enum {
 #define EPNUM_CDC_2_NOTIF 0x85
 #define EPNUM_CDC_2_OUT   0x06
 #define EPNUM_CDC_2_IN    0x86
+#define EPNUM_CDC_3_NOTIF 0x87
+#define EPNUM_CDC_3_OUT   0x08
+#define EPNUM_CDC_3_IN    0x88
+#define EPNUM_CDC_4_NOTIF 0x89
+#define EPNUM_CDC_4_OUT   0x0A
+#define EPNUM_CDC_4_IN    0x8A
+#define EPNUM_ADAPTER_OUT 0x0B
+#define EPNUM_ADAPTER_IN  0x8B
+#define EPNUM_STREAM_OUT  0x0C
+#define EPNUM_STREAM_IN   0x8C
+#define EPNUM_CDC_5_NOTIF 0x8D
+#define EPNUM_CDC_5_OUT   0x0E
+#define EPNUM_CDC_5_IN    0x8E
+#define EPNUM_MSC_OUT     0x0F
+#define EPNUM_MSC_IN      0x8F
 
 uint8_t const desc_configuration[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, 4, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, 64),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, 5, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, 64),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_2, 6, EPNUM_CDC_2_NOTIF, 8, EPNUM_CDC_2_OUT, EPNUM_CDC_2_IN, 64),
+#if I2CONSOLE_SNIFFER
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_SNIFFER, 7, EPNUM_CDC_3_NOTIF, 8, EPNUM_CDC_3_OUT, EPNUM_CDC_3_IN, 64),
+#endif
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_TELEMETRY, 8, EPNUM_CDC_4_NOTIF, 8, EPNUM_CDC_4_OUT, EPNUM_CDC_4_IN, 64),
+#if UART_BRIDGE_CHANNELS > 1
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_UART2, 11, EPNUM_CDC_5_NOTIF, 8, EPNUM_CDC_5_OUT, EPNUM_CDC_5_IN, 64),
+#endif
+#if UART_BRIDGE_CHANNELS > 2
+    // Only built without the sniffer, so its endpoints are free
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_UART3, 12, EPNUM_CDC_3_NOTIF, 8, EPNUM_CDC_3_OUT, EPNUM_CDC_3_IN, 64),
+#endif
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR_ADAPTER, 9, EPNUM_ADAPTER_OUT, EPNUM_ADAPTER_IN, 64),
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR_STREAM, 10, EPNUM_STREAM_OUT, EPNUM_STREAM_IN, 64),
+#if I2CONSOLE_MSC
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 13, EPNUM_MSC_OUT, EPNUM_MSC_IN, 64),
+#endif
 };
 
 uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
@@ -59,6 +114,78 @@ uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
     return desc_configuration;
 }
 
+// --- WinUSB (MS OS 2.0) ---
+// Windows binds WinUSB to both vendor interfaces without an INF file;
+// libusb on Linux/macOS needs nothing extra.
+
+#define VENDOR_REQUEST_MICROSOFT 0x01
+#define MS_OS_20_DESC_INDEX 7
+
+#define MS_OS_20_FUNCTION_LEN 0xA0
+#define MS_OS_20_DESC_LEN (0x0A + 0x08 + 2 * MS_OS_20_FUNCTION_LEN)
+
+#define W(c) c, 0
+
+// Function subset: WinUSB compatible ID plus a DeviceInterfaceGUIDs
+// property so host tools can find the interface by GUID
+#define MS_OS_20_FUNCTION(itf, ...) \
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), itf, 0, \
+    U16_TO_U8S_LE(MS_OS_20_FUNCTION_LEN), \
+    U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID), \
+    'W', 'I', 'N', 'U', 'S', 'B', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, \
+    U16_TO_U8S_LE(0x0084), U16_TO_U8S_LE(MS_OS_20_FEATURE_REG_PROPERTY), \
+    U16_TO_U8S_LE(0x0007), U16_TO_U8S_LE(0x002A), \
+    W('D'), W('e'), W('v'), W('i'), W('c'), W('e'), W('I'), W('n'), W('t'), W('e'), W('r'), \
+    W('f'), W('a'), W('c'), W('e'), W('G'), W('U'), W('I'), W('D'), W('s'), W(0), \
+    U16_TO_U8S_LE(0x0050), __VA_ARGS__, W(0), W(0)
+
+uint8_t const desc_ms_os_20[] = {
+    U16_TO_U8S_LE(0x000A), U16_TO_U8S_LE(MS_OS_20_SET_HEADER_DESCRIPTOR),
+    U32_TO_U8S_LE(0x06030000), U16_TO_U8S_LE(MS_OS_20_DESC_LEN),
+
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION), 0, 0,
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
+
+    // {9D6F3A5E-2C41-4B8A-9E7D-5A1C3F0B2D61}
+    MS_OS_20_FUNCTION(ITF_NUM_VENDOR_ADAPTER,
+        W('{'), W('9'), W('D'), W('6'), W('F'), W('3'), W('A'), W('5'), W('E'), W('-'),
+        W('2'), W('C'), W('4'), W('1'), W('-'), W('4'), W('B'), W('8'), W('A'), W('-'),
+        W('9'), W('E'), W('7'), W('D'), W('-'), W('5'), W('A'), W('1'), W('C'), W('3'),
+        W('F'), W('0'), W('B'), W('2'), W('D'), W('6'), W('1'), W('}')),
+
+    // {4E2B7C19-8A53-4D6E-B1F4-2C9A6E0D7B38}
+    MS_OS_20_FUNCTION(ITF_NUM_VENDOR_STREAM,
+        W('{'), W('4'), W('E'), W('2'), W('B'), W('7'), W('C'), W('1'), W('9'), W('-'),
+        W('8'), W('A'), W('5'), W('3'), W('-'), W('4'), W('D'), W('6'), W('E'), W('-'),
+        W('B'), W('1'), W('F'), W('4'), W('-'), W('2'), W('C'), W('9'), W('A'), W('6'),
+        W('E'), W('0'), W('D'), W('7'), W('B'), W('3'), W('8'), W('}')),
+};
+
+_Static_assert(sizeof(desc_ms_os_20) == MS_OS_20_DESC_LEN, "MS OS 2.0 descriptor length");
+
+#define BOS_TOTAL_LEN (TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN)
+
+uint8_t const desc_bos[] = {
+    TUD_BOS_DESCRIPTOR(BOS_TOTAL_LEN, 1),
+    TUD_BOS_MS_OS_20_DESCRIPTOR(MS_OS_20_DESC_LEN, VENDOR_REQUEST_MICROSOFT),
+};
+
+uint8_t const *tud_descriptor_bos_cb(void) {
+    return desc_bos;
+}
+
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
+    if (stage != CONTROL_STAGE_SETUP) return true;
+
+    if (request->bmRequestType_bit.type == TUSB_REQ_TYPE_VENDOR &&
+        request->bRequest == VENDOR_REQUEST_MICROSOFT &&
+        request->wIndex == MS_OS_20_DESC_INDEX) {
+        return tud_control_xfer(rhport, request, (void *)(uintptr_t)desc_ms_os_20,
+                                sizeof(desc_ms_os_20));
+    }
+    return false;
+}
+
 char const *string_desc_arr[] = {
     (const char[]){0x09, 0x04},
     "metaneutrons",
@@ -97,6 +224,20 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
         set_desc_string("I2Console UART", &chr_count);
     } else if (index == 6) {
         set_desc_string("I2Console Debug", &chr_count);
+    } else if (index == 7) {
+        set_desc_string("I2Console Sniffer", &chr_count);
+    } else if (index == 8) {
+        set_desc_string("I2Console Telemetry", &chr_count);
+    } else if (index == 9) {
+        set_desc_string("I2Console I2C Adapter", &chr_count);
+    } else if (index == 10) {
+        set_desc_string("I2Console Stream", &chr_count);
+    } else if (index == 11) {
+        set_desc_string("I2Console UART 2", &chr_count);
+    } else if (index == 12) {
+        set_desc_string("I2Console UART 3", &chr_count);
+    } else if (index == 13) {
+        set_desc_string("I2Console History", &chr_count);
     } else {
         if (!(index < sizeof(string_desc_arr) / sizeof(string_desc_arr[0]))) return NULL;
         const char *str = string_desc_arr[index];
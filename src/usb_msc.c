@@ -0,0 +1,249 @@
+#include "usb_msc.h"
+#include "history.h"
+#include "log.h"
+#include "tusb.h"
+#include <string.h>
+
+#define DIR_ENTRY_SIZE 32
+#define ROOT_DIR_SECTORS (USB_MSC_ROOT_ENTRIES * DIR_ENTRY_SIZE / USB_MSC_SECTOR_SIZE)
+#define FAT_START USB_MSC_RESERVED_SECTORS
+#define ROOT_START (FAT_START + USB_MSC_FAT_COUNT * USB_MSC_FAT_SECTORS)
+#define DATA_START (ROOT_START + ROOT_DIR_SECTORS)
+#define CLUSTER_COUNT (USB_MSC_SECTOR_COUNT - DATA_START)
+#define FAT_ENTRIES_PER_SECTOR (USB_MSC_SECTOR_SIZE / 2)
+
+// FAT type is decided by cluster count alone
+_Static_assert(CLUSTER_COUNT >= 4085 && CLUSTER_COUNT < 65525, "volume must be FAT16");
+_Static_assert((CLUSTER_COUNT + 2) * 2 <= USB_MSC_FAT_SECTORS * USB_MSC_SECTOR_SIZE,
+               "FAT too small for the volume");
+
+#define FAT_DATE (((2025 - 1980) << 9) | (1 << 5) | 1)  // 2025-01-01
+#define ATTR_READ_ONLY 0x01
+#define ATTR_VOLUME_ID 0x08
+
+static const struct {
+    char name[11];  // 8.3, space padded
+    history_file_t file;
+} files[] = {
+    {"INFO    TXT", HISTORY_FILE_INFO},
+    {"CONSOLE TXT", HISTORY_FILE_CONSOLE},
+    {"LOG     TXT", HISTORY_FILE_LOG},
+};
+#define FILE_COUNT (sizeof(files) / sizeof(files[0]))
+
+// Each file owns a fixed run of clusters sized for its capacity, so the
+// layout never moves between snapshots
+static uint16_t first_cluster[FILE_COUNT];
+static uint8_t sector[USB_MSC_SECTOR_SIZE];
+static usb_msc_stats_t stats = {0};
+static bool media_changed = false;
+
+static uint32_t clusters_for(size_t bytes) {
+    return (bytes + USB_MSC_SECTOR_SIZE - 1) / USB_MSC_SECTOR_SIZE;
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+static void build_boot_sector(uint8_t *s) {
+    static const uint8_t jump[3] = {0xEB, 0x3C, 0x90};
+    memcpy(s, jump, 3);
+    memcpy(s + 3, "MSWIN4.1", 8);
+    put16(s + 11, USB_MSC_SECTOR_SIZE);
+    s[13] = 1;  // sectors per cluster
+    put16(s + 14, USB_MSC_RESERVED_SECTORS);
+    s[16] = USB_MSC_FAT_COUNT;
+    put16(s + 17, USB_MSC_ROOT_ENTRIES);
+    put16(s + 19, USB_MSC_SECTOR_COUNT);
+    s[21] = 0xF8;  // fixed media
+    put16(s + 22, USB_MSC_FAT_SECTORS);
+    put16(s + 24, 32);  // sectors per track
+    put16(s + 26, 2);   // heads
+    s[36] = 0x80;  // drive number
+    s[38] = 0x29;  // extended boot signature
+    put32(s + 39, 0x12C02025);
+    memcpy(s + 43, "I2CONSOLE  ", 11);
+    memcpy(s + 54, "FAT16   ", 8);
+    s[510] = 0x55;
+    s[511] = 0xAA;
+}
+
+static void build_fat_sector(uint32_t index, uint8_t *s) {
+    for (uint32_t i = 0; i < FAT_ENTRIES_PER_SECTOR; i++) {
+        uint32_t cluster = index * FAT_ENTRIES_PER_SECTOR + i;
+        uint16_t next = 0;
+        if (cluster == 0) {
+            next = 0xFFF8;  // media byte
+        } else if (cluster == 1) {
+            next = 0xFFFF;
+        } else {
+            for (size_t f = 0; f < FILE_COUNT; f++) {
+                uint32_t n = clusters_for(history_file_size(files[f].file));
+                if (n == 0 || cluster < first_cluster[f] || cluster >= first_cluster[f] + n) continue;
+                next = cluster == first_cluster[f] + n - 1 ? 0xFFFF : cluster + 1;
+                break;
+            }
+        }
+        put16(s + 2 * i, next);
+    }
+}
+
+static void build_dir_entry(uint8_t *e, const char *name, uint8_t attr, uint16_t cluster,
+                            uint32_t size) {
+    memcpy(e, name, 11);
+    e[11] = attr;
+    put16(e + 14, 0);         // creation time
+    put16(e + 16, FAT_DATE);  // creation date
+    put16(e + 18, FAT_DATE);  // access date
+    put16(e + 22, 0);         // write time
+    put16(e + 24, FAT_DATE);  // write date
+    put16(e + 26, cluster);
+    put32(e + 28, size);
+}
+
+static void build_root_sector(uint32_t index, uint8_t *s) {
+    if (index != 0) return;
+    build_dir_entry(s, "I2CONSOLE  ", ATTR_VOLUME_ID, 0, 0);
+    for (size_t f = 0; f < FILE_COUNT; f++) {
+        size_t size = history_file_size(files[f].file);
+        build_dir_entry(s + (f + 1) * DIR_ENTRY_SIZE, files[f].name, ATTR_READ_ONLY,
+                        size ? first_cluster[f] : 0, size);
+    }
+}
+
+static void build_data_sector(uint32_t lba, uint8_t *s) {
+    uint32_t cluster = lba - DATA_START + 2;
+    for (size_t f = 0; f < FILE_COUNT; f++) {
+        uint32_t n = clusters_for(history_file_capacity(files[f].file));
+        if (cluster < first_cluster[f] || cluster >= first_cluster[f] + n) continue;
+        uint32_t offset = (cluster - first_cluster[f]) * USB_MSC_SECTOR_SIZE;
+        history_read(files[f].file, offset, s, USB_MSC_SECTOR_SIZE);
+        return;
+    }
+}
+
+static void build_sector(uint32_t lba, uint8_t *s) {
+    memset(s, 0, USB_MSC_SECTOR_SIZE);
+    if (lba == 0) {
+        build_boot_sector(s);
+    } else if (lba < ROOT_START) {
+        build_fat_sector((lba - FAT_START) % USB_MSC_FAT_SECTORS, s);
+    } else if (lba < DATA_START) {
+        build_root_sector(lba - ROOT_START, s);
+    } else if (lba < USB_MSC_SECTOR_COUNT) {
+        build_data_sector(lba, s);
+    }
+}
+
+void usb_msc_init(void) {
+    uint32_t cluster = 2;
+    for (size_t f = 0; f < FILE_COUNT; f++) {
+        first_cluster[f] = cluster;
+        cluster += clusters_for(history_file_capacity(files[f].file));
+    }
+    if (cluster - 2 > CLUSTER_COUNT) {
+        LOG_ERROR("MSC: history larger than the volume");
+    }
+}
+
+void usb_msc_refresh(void) {
+    history_snapshot();
+    stats.refreshes++;
+    media_changed = true;
+}
+
+usb_msc_stats_t usb_msc_get_stats(void) {
+    return stats;
+}
+
+// TinyUSB MSC callbacks
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16],
+                        uint8_t product_rev[4]) {
+    (void)lun;
+    memcpy(vendor_id, "I2Consol", 8);
+    memcpy(product_id, "History         ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+    if (stats.ejected) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);  // medium not present
+        return false;
+    }
+    if (media_changed) {
+        // Makes the host drop its cached FAT and directory
+        media_changed = false;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, 0x28, 0x00);
+        return false;
+    }
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size) {
+    (void)lun;
+    *block_count = USB_MSC_SECTOR_COUNT;
+    *block_size = USB_MSC_SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject) {
+    (void)lun;
+    (void)power_condition;
+    if (load_eject) {
+        stats.ejected = !start;
+        if (start) usb_msc_refresh();
+    }
+    return true;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer,
+                          uint32_t bufsize) {
+    (void)lun;
+    uint8_t *out = buffer;
+    uint32_t done = 0;
+    while (done < bufsize) {
+        build_sector(lba, sector);
+        uint32_t n = USB_MSC_SECTOR_SIZE - offset;
+        if (n > bufsize - done) n = bufsize - done;
+        memcpy(out + done, sector + offset, n);
+        done += n;
+        offset = 0;
+        lba++;
+        stats.sectors_read++;
+    }
+    return done;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun) {
+    (void)lun;
+    return false;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer,
+                           uint32_t bufsize) {
+    (void)lba;
+    (void)offset;
+    (void)buffer;
+    (void)bufsize;
+    tud_msc_set_sense(lun, SCSI_SENSE_DATA_PROTECT, 0x27, 0x00);  // write protected
+    return -1;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize) {
+    (void)buffer;
+    (void)bufsize;
+    switch (scsi_cmd[0]) {
+    case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+        return 0;
+    default:
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);  // invalid command
+        return -1;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef USB_MSC_H
+#define USB_MSC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Read-only mass storage view of the captured history. The FAT16 volume is
+// never stored: boot sector, FATs, directory and file data are generated
+// per sector from the current history snapshot.
+//
+// 4 MB of 512-byte clusters keeps the cluster count in FAT16 range; only
+// the first few hundred sectors ever hold data.
+#define USB_MSC_SECTOR_SIZE 512
+#define USB_MSC_SECTOR_COUNT 8192
+#define USB_MSC_RESERVED_SECTORS 1
+#define USB_MSC_FAT_COUNT 2
+#define USB_MSC_FAT_SECTORS 32
+#define USB_MSC_ROOT_ENTRIES 16
+
+typedef struct {
+    uint32_t sectors_read;
+    uint32_t refreshes;
+    bool ejected;
+} usb_msc_stats_t;
+
+void usb_msc_init(void);
+// Takes a new history snapshot and tells the host the medium has changed
+void usb_msc_refresh(void);
+usb_msc_stats_t usb_msc_get_stats(void);
+
+#endif
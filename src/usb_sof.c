@@ -0,0 +1,101 @@
+#include "usb_sof.h"
+#include "usb_stream.h"
+#include "tusb.h"
+#include "hardware/structs/usb.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+static usb_sof_stats_t stats = {0};
+static uint32_t last_report_ms = 0;
+
+void usb_sof_init(void) {
+    stats = (usb_sof_stats_t){0};
+    last_report_ms = to_ms_since_boot(get_absolute_time());
+    tud_sof_cb_enable(true);
+}
+
+// Device time and frame number of the most recent SOF, and how long ago
+// it was. Reading SOF_RD also clears the SOF interrupt; that only matters
+// if a newer SOF is pending, and then the sample is discarded anyway.
+static uint64_t last_sof_us(uint16_t *frame, uint32_t *age_us) {
+    uint32_t ints = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    uint32_t raw = usb_hw->sof_timestamp_raw;
+    uint32_t last = usb_hw->sof_timestamp_last;
+    *frame = usb_hw->sof_rd & USB_SOF_FRAME_MASK;
+    restore_interrupts(ints);
+
+    uint32_t ticks = (raw - last) & USB_SOF_TIMESTAMP_RAW_BITS;
+    *age_us = ticks / USB_SOF_PHY_TICKS_PER_US;
+    return now - *age_us;
+}
+
+static bool follows_last_sample(uint16_t frame, uint64_t sof_us) {
+    if (!stats.valid || sof_us - stats.sof_us > USB_SOF_CHECK_WINDOW_US) return true;
+    uint32_t frames = (sof_us - stats.sof_us + USB_SOF_FRAME_US / 2) / USB_SOF_FRAME_US;
+    return ((stats.frame + frames) & USB_SOF_FRAME_MASK) == frame;
+}
+
+// TinyUSB SOF callback, once per frame from tud_task()
+void tud_sof_cb(uint32_t frame_count) {
+    stats.frames++;
+
+    uint16_t hw_frame;
+    uint32_t age_us;
+    uint64_t sof_us = last_sof_us(&hw_frame, &age_us);
+    uint16_t frame = frame_count & USB_SOF_FRAME_MASK;
+    // A queued callback for an older SOF: the timestamp belongs to a newer
+    // frame. Too old and the pair is less trustworthy anyway.
+    if (hw_frame != frame || age_us > USB_SOF_MAX_AGE_US) {
+        stats.late++;
+        return;
+    }
+    if (!follows_last_sample(frame, sof_us)) {
+        stats.mismatch++;
+        return;
+    }
+
+    stats.frame = frame;
+    stats.sof_us = sof_us;
+    stats.samples++;
+    stats.valid = true;
+}
+
+static void send_sample(void) {
+    // [frame LE16][SOF device time µs LE64]
+    uint8_t payload[10];
+    uint64_t t = stats.sof_us;
+    payload[0] = stats.frame & 0xFF;
+    payload[1] = stats.frame >> 8;
+    for (int i = 0; i < 8; i++) {
+        payload[2 + i] = (t >> (8 * i)) & 0xFF;
+    }
+    usb_stream_write_record(STREAM_REC_SOF, payload, sizeof(payload));
+}
+
+void usb_sof_task(void) {
+    // No SOFs while suspended or detached; an old pair would still be
+    // correct but can no longer be checked against the next one
+    if (!tud_mounted() || tud_suspended()) {
+        stats.valid = false;
+        return;
+    }
+
+    if (!stats.valid || !usb_stream_active()) return;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (now - last_report_ms >= USB_SOF_REPORT_INTERVAL_MS) {
+        last_report_ms = now;
+        send_sample();
+    }
+}
+
+usb_sof_stats_t usb_sof_get_stats(void) {
+    return stats;
+}
+
+void usb_sof_reset_stats(void) {
+    stats.frames = 0;
+    stats.samples = 0;
+    stats.late = 0;
+    stats.mismatch = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef USB_SOF_H
+#define USB_SOF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pairs the device microsecond timer with USB start-of-frame numbers. The
+// host sees the same frames on its own clock, so one pair maps any device
+// timestamp onto host time.
+//
+// The frame number comes from the TinyUSB SOF callback, which runs in task
+// context. The time of that SOF comes from the controller's 48 MHz SOF
+// timestamp, so main-loop latency does not skew the pair. A sample is only
+// taken when the controller's current frame number is the callback's (no
+// newer SOF in between), the callback runs soon after its SOF, and the
+// frame number agrees with the previous sample.
+#define USB_SOF_FRAME_US 1000
+#define USB_SOF_FRAME_MASK 0x7FF           // 11-bit frame counter, wraps every 2.048 s
+#define USB_SOF_PHY_TICKS_PER_US 48
+#define USB_SOF_MAX_AGE_US 250             // callback later than this after its SOF: skip
+#define USB_SOF_CHECK_WINDOW_US 100000     // frame continuity is checked against samples this recent
+#define USB_SOF_REPORT_INTERVAL_MS 1000    // STREAM_REC_SOF rate while the stream is active
+
+typedef struct {
+    bool valid;         // a sample has been taken since the bus last went idle
+    uint16_t frame;     // frame number of the last sample
+    uint64_t sof_us;    // device time (time_us_64) at the start of that frame
+    uint32_t frames;    // SOF callbacks seen
+    uint32_t samples;   // callbacks that produced a sample
+    uint32_t late;      // skipped: a newer SOF arrived, or the callback ran too late
+    uint32_t mismatch;  // skipped: frame number didn't follow the previous sample
+} usb_sof_stats_t;
+
+void usb_sof_init(void);
+void usb_sof_task(void);
+usb_sof_stats_t usb_sof_get_stats(void);
+void usb_sof_reset_stats(void);
+
+#endif
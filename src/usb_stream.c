@@ -0,0 +1,132 @@
+#include "usb_stream.h"
+#include "i2c_slave.h"
+#include "log.h"
+#include "tusb.h"
+#include "pico/time.h"
+
+static usb_stream_stats_t stats = {0};
+static uint32_t last_stats_ms = 0;
+static bool pending_flush = false;
+
+void usb_stream_init(void) {
+    stats = (usb_stream_stats_t){0};
+    last_stats_ms = to_ms_since_boot(get_absolute_time());
+}
+
+static void set_active(bool active) {
+    if (active == stats.active) return;
+    stats.active = active;
+    if (active) {
+        LOG_INFO("Vendor stream started");
+        usb_stream_event(STREAM_EVT_STARTED, 0);
+    } else {
+        LOG_INFO("Vendor stream stopped");
+    }
+}
+
+static void send_stats(void) {
+    i2c_stats_t i2c = i2c_slave_get_stats();
+    uint32_t counters[8] = {
+        i2c.tx_bytes,
+        i2c.rx_bytes,
+        i2c.tx_overflow,
+        i2c.rx_overflow,
+        i2c.i2c_errors,
+        i2c.recoveries,
+        stats.records,
+        stats.dropped,
+    };
+    // Cortex-M is little endian, so the array is already in wire order
+    usb_stream_write_record(STREAM_REC_STATS, counters, sizeof(counters));
+}
+
+void usb_stream_task(void) {
+    if (!tud_vendor_n_mounted(USB_STREAM_VENDOR_ITF)) {
+        set_active(false);
+        return;
+    }
+
+    while (tud_vendor_n_available(USB_STREAM_VENDOR_ITF)) {
+        uint8_t cmd;
+        tud_vendor_n_read(USB_STREAM_VENDOR_ITF, &cmd, 1);
+        if (cmd == STREAM_CMD_START) {
+            set_active(true);
+        } else if (cmd == STREAM_CMD_STOP) {
+            set_active(false);
+        }
+    }
+
+    if (!stats.active) return;
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (now - last_stats_ms >= USB_STREAM_STATS_INTERVAL_MS) {
+        last_stats_ms = now;
+        send_stats();
+    }
+
+    if (pending_flush) {
+        tud_vendor_n_write_flush(USB_STREAM_VENDOR_ITF);
+        pending_flush = false;
+    }
+}
+
+bool usb_stream_active(void) {
+    return stats.active;
+}
+
+int usb_stream_space(void) {
+    if (!stats.active) return 0;
+    int space = (int)tud_vendor_n_write_available(USB_STREAM_VENDOR_ITF) - USB_STREAM_HEADER_SIZE;
+    if (space < 0) return 0;
+    return space > USB_STREAM_MAX_PAYLOAD ? USB_STREAM_MAX_PAYLOAD : space;
+}
+
+// Records are written whole or not at all, so the host never sees a torn one
+bool usb_stream_write_record(uint8_t type, const void *payload, uint16_t len) {
+    if (!stats.active) return false;
+    if (len > USB_STREAM_MAX_PAYLOAD ||
+        tud_vendor_n_write_available(USB_STREAM_VENDOR_ITF) < USB_STREAM_HEADER_SIZE + (uint32_t)len) {
+        stats.dropped++;
+        return false;
+    }
+
+    uint32_t ts = time_us_32();
+    uint8_t header[USB_STREAM_HEADER_SIZE] = {
+        USB_STREAM_MAGIC,
+        type,
+        len & 0xFF,
+        len >> 8,
+        ts & 0xFF,
+        (ts >> 8) & 0xFF,
+        (ts >> 16) & 0xFF,
+        (ts >> 24) & 0xFF,
+    };
+    tud_vendor_n_write(USB_STREAM_VENDOR_ITF, header, sizeof(header));
+    if (len > 0) {
+        tud_vendor_n_write(USB_STREAM_VENDOR_ITF, payload, len);
+    }
+
+    stats.records++;
+    stats.bytes += USB_STREAM_HEADER_SIZE + len;
+    pending_flush = true;
+    return true;
+}
+
+void usb_stream_event(uint8_t event, uint32_t arg) {
+    uint8_t payload[5] = {
+        event,
+        arg & 0xFF,
+        (arg >> 8) & 0xFF,
+        (arg >> 16) & 0xFF,
+        (arg >> 24) & 0xFF,
+    };
+    usb_stream_write_record(STREAM_REC_EVENT, payload, sizeof(payload));
+}
+
+usb_stream_stats_t usb_stream_get_stats(void) {
+    return stats;
+}
+
+void usb_stream_reset_stats(void) {
+    stats = (usb_stream_stats_t){.active = stats.active};
+}
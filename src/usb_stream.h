@@ -0,0 +1,47 @@
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary record stream on the second vendor bulk interface.
+// Record: [0xA5][type][len LE16][device time µs LE32][payload...]
+#define USB_STREAM_VENDOR_ITF 1
+#define USB_STREAM_MAGIC 0xA5
+#define USB_STREAM_HEADER_SIZE 8
+#define USB_STREAM_MAX_PAYLOAD 512
+#define USB_STREAM_STATS_INTERVAL_MS 1000
+
+// Record types
+#define STREAM_REC_CONSOLE 0x01  // console bytes written by the I2C master
+#define STREAM_REC_STATS   0x10  // u32 LE counters, see README
+#define STREAM_REC_EVENT   0x20  // [event][arg LE32]
+#define STREAM_REC_UART    0x30  // [channel][first byte time µs LE32][data...]
+#define STREAM_REC_SOF     0x40  // [frame LE16][SOF device time µs LE64]
+
+// Events
+#define STREAM_EVT_STARTED      0x01
+#define STREAM_EVT_I2C_RECOVERY 0x02
+
+// Host commands on the OUT endpoint
+#define STREAM_CMD_START 'S'
+#define STREAM_CMD_STOP  'X'
+
+typedef struct {
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t dropped;  // records that didn't fit in the endpoint FIFO
+    bool active;
+} usb_stream_stats_t;
+
+void usb_stream_init(void);
+void usb_stream_task(void);
+bool usb_stream_active(void);
+// Payload bytes that fit in a single record right now
+int usb_stream_space(void);
+bool usb_stream_write_record(uint8_t type, const void *payload, uint16_t len);
+void usb_stream_event(uint8_t event, uint32_t arg);
+usb_stream_stats_t usb_stream_get_stats(void);
+void usb_stream_reset_stats(void);
+
+#endif